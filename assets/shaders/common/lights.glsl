@@ -0,0 +1,144 @@
+//The lights shared by the lit shaders. The including shader must define "shade_light" which combines the terms of a light
+//with its material, then it calls "accumulate_lights" to sum the contributions of the lights that reach the fragment.
+
+//The members are ordered such that each vec3 is followed by a scalar which fills the 4th component of a texel in the light data
+struct Light {
+   //Phong model (ambient, diffuse, specular)
+   vec3 diffuse;
+   int type; //0 point, 1 directional, 2 spot
+   vec3 specular;
+   //attenuation -> used for spot and point light types
+	//intensity of the light is affected by this equation -> 1/(a + b*d + c*d^2)
+	//where a is attenuation_constant, b is attenuation_linear and c is attenuation_quadratic
+   float attenuation_constant;
+   vec3 ambient;
+   float attenuation_linear;
+   //Position  -> for spot and point light types
+	//Direction -> for spot and directional light types
+   vec3 position;
+   float attenuation_quadratic;
+   vec3 direction;
+   //For spot light -> to define the inner and outer cones of spot light
+	//For the space that lies between outer and inner cones, light intensity is interpolated
+   float inner_angle;
+   float outer_angle;
+};
+
+#define TYPE_POINT          0
+#define TYPE_DIRECTIONAL    1
+#define TYPE_SPOT           2
+
+//The lights are culled by the renderer into clusters (screen tiles split into slices along the view depth, see "LightClusters")
+//The block holds what is needed to find the cluster of a fragment. It must match "LightBlock" in "source/common/systems/light-clusters.hpp"
+layout(std140) uniform Lights {
+   //the view depth of a world position is dot(view_depth, vec4(position, 1))
+   vec4 view_depth;
+   //the ambient term is not attenuated so the ambient colors of all the lights are summed by the renderer
+   vec3 ambient_light;
+   //the directional lights are the first lights of the light data and they light every fragment
+   int directional_light_count;
+   //the number of clusters along x, y and z
+   ivec4 cluster_grid;
+   //the cluster size in pixels (x, y) then the scale and bias that map log(depth) to a slice (z, w)
+   vec4 cluster_params;
+};
+//The lights (6 texels each), the (first index, point count | spot count << 16) of each cluster and the light indices of all clusters
+uniform samplerBuffer light_data;
+uniform usamplerBuffer cluster_ranges;
+uniform usamplerBuffer light_indices;
+
+//If the renderer did not compile this shader for the light mix of the frame, all the light types are handled
+#ifndef DIRECTIONAL_LIGHT_COUNT
+#define DIRECTIONAL_LIGHT_COUNT directional_light_count
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 1
+#endif
+#ifndef SPOT_LIGHTS
+#define SPOT_LIGHTS 1
+#endif
+
+//Reads a light from the light data (the layout must match "LightData" in "source/common/systems/light-clusters.hpp")
+Light fetch_light(int index){
+   int base = index * 6;
+   vec4 texel0 = texelFetch(light_data, base);
+   vec4 texel1 = texelFetch(light_data, base + 1);
+   vec4 texel2 = texelFetch(light_data, base + 2);
+   vec4 texel3 = texelFetch(light_data, base + 3);
+   vec4 texel4 = texelFetch(light_data, base + 4);
+   vec4 texel5 = texelFetch(light_data, base + 5);
+   return Light(texel0.xyz, int(texel0.w), texel1.xyz, texel1.w, texel2.xyz, texel2.w,
+                texel3.xyz, texel3.w, texel4.xyz, texel4.w, texel5.x);
+}
+
+//Returns the index of the cluster containing the fragment
+int find_cluster(vec3 world){
+   float depth = max(dot(view_depth, vec4(world, 1.0)), 1e-4);
+   ivec3 cell = ivec3(ivec2(gl_FragCoord.xy / cluster_params.xy), int(floor(log(depth) * cluster_params.z + cluster_params.w)));
+   cell = clamp(cell, ivec3(0), cluster_grid.xyz - 1);
+   return cell.x + cluster_grid.x * (cell.y + cluster_grid.y * cell.z);
+}
+
+//Combines the lambert & phong factors and the attenuation of a light with the material (defined by the including shader)
+//The ambient term is not included since it is added once for all the lights by "accumulate_lights"
+vec3 shade_light(Light light, float lambert, float phong, float attenuation);
+
+//Computes the contribution of a single light of the given type
+//When the type is a constant, the compiler removes the branches of the other types
+vec3 light_contribution(Light light, int type, vec3 world, vec3 normal, vec3 view, float shininess){
+   vec3 light_direction;
+   //set initial value for attenuation as no attenuation in directional light
+   float attenuation = 1;
+   if(type == TYPE_DIRECTIONAL)
+      light_direction = light.direction;
+   else {
+      //for point and spot lights we calculate the light direction
+      light_direction = world - light.position;
+      //length function returns sqrt(x[0]^2 + x[1]^2 + ......);
+      float distance = length(light_direction);
+      //getting unit vector that has the same direction of the light
+      light_direction /= distance;
+      //calculating flactuations in intensity due to the distance from light source
+      attenuation *= 1.0f / (light.attenuation_constant +
+                     light.attenuation_linear * distance +
+                     light.attenuation_quadratic * distance * distance);
+      if(type == TYPE_SPOT){
+         //for spot lights get inner and outer cone -> add thyeir effect to the attenuation
+         float angle = acos(dot(light.direction, light_direction));
+         attenuation *= smoothstep(light.outer_angle, light.inner_angle, angle);
+      }
+   }
+   //reflect function takes (incident, normal) and returns the reflection direction calculated as I - 2.0 * dot(N, I) * N
+   //For the function to work correctly normal vector must be normalized
+   vec3 reflected = reflect(light_direction, normal);
+   //calculate lambert and phong factors
+   float lambert = max(0.0f, dot(normal, -light_direction));
+   float phong = pow(max(0.0f, dot(view, reflected)), shininess);
+   return shade_light(light, lambert, phong, attenuation);
+}
+
+//Sums the contributions of all the lights
+//The directional lights light every fragment, while the point and spot lights are only read from the list of the fragment's cluster
+//(where the point lights come first). Since each loop handles a single light type, no type is checked per light.
+//If the renderer compiled this shader for the light mix of the frame, the number of directional lights is a constant
+//and the loops over the light types that the frame doesn't have are removed.
+vec3 accumulate_lights(vec3 world, vec3 normal, vec3 view, float shininess, vec3 material_ambient){
+   vec3 accumulated_light = material_ambient * ambient_light;
+   for(int index = 0; index < DIRECTIONAL_LIGHT_COUNT; index++)
+      accumulated_light += light_contribution(fetch_light(index), TYPE_DIRECTIONAL, world, normal, view, shininess);
+#if POINT_LIGHTS || SPOT_LIGHTS
+   uvec2 range = texelFetch(cluster_ranges, find_cluster(world)).xy;
+   int first = int(range.x);
+   int point_count = int(range.y & 0xFFFFu);
+#if POINT_LIGHTS
+   for(int index = first; index < first + point_count; index++)
+      accumulated_light += light_contribution(fetch_light(int(texelFetch(light_indices, index).x)), TYPE_POINT, world, normal, view, shininess);
+#endif
+#if SPOT_LIGHTS
+   int spot_count = int(range.y >> 16u);
+   for(int index = first + point_count; index < first + point_count + spot_count; index++)
+      accumulated_light += light_contribution(fetch_light(int(texelFetch(light_indices, index).x)), TYPE_SPOT, world, normal, view, shininess);
+#endif
+#endif
+   return accumulated_light;
+}
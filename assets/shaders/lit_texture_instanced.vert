@@ -0,0 +1,40 @@
+#version 330 core
+
+// The instanced variant of "lit_texture.vert"
+// The per object transforms are read from the instance buffer instead of uniforms
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 tex_coord;
+layout(location = 3) in vec3 normal;
+// Each mat4 takes 4 consecutive locations (4 to 7 and 8 to 11)
+layout(location = 4) in mat4 objectToWorld;
+layout(location = 8) in mat4 objectToInvTranspose;
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+    //The vertex position relative to the world space
+    vec3 world;
+    //vector from the vertex to the eye relative to the world space
+    vec3 view;
+    //normal on the surface relative to the world space
+    vec3 normal;
+} vs_out;
+
+// The view projection matrix is shared by all the instances
+uniform mat4 VP;
+//used to calculate the specular
+uniform vec3 cameraPosition;
+
+void main(){
+    //calculate the position relative to the world space
+    vs_out.world = (objectToWorld * vec4(position, 1.0f)).xyz;
+    gl_Position = VP * vec4(vs_out.world, 1.0);
+    vs_out.tex_coord = tex_coord;
+    //calculate the view vector relative to the world space to be passed to the fragment shader to calculate the phong factor
+    vs_out.view = cameraPosition - vs_out.world;
+    vs_out.color = color;
+    //calculate the normal
+    vs_out.normal = normalize((objectToInvTranspose * vec4(normal, 0.0f)).xyz);
+}
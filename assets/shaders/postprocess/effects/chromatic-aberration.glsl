@@ -0,0 +1,18 @@
+// A neighbourhood effect of the postprocess chain (see "source/common/systems/postprocess-chain.hpp")
+
+// How far (in the texture space) is the distance (on the x-axis) between
+// the pixels from which the red/green (or green/blue) channels are sampled
+#define CHROMATIC_ABERRATION_STRENGTH 0.005
+
+// Chromatic aberration mimics some old cameras where the lens disperses light
+// differently based on its wavelength. In this shader, we will implement a
+// cheap version of that effect
+vec4 chromatic_aberration(sampler2D source, vec2 uv){
+    // To apply this effect, we only read the green channel from the correct pixel (as defined by uv)
+    // To get the red channel, we move by amount STRENGTH to the left then sample another pixel from which we take the red channel
+    // To get the blue channel, we move by amount STRENGTH to the right then sample another pixel from which we take the blue channel
+    vec4 color = texture(source, uv);
+    color.r = texture(source, uv - vec2(CHROMATIC_ABERRATION_STRENGTH, 0)).r;
+    color.b = texture(source, uv + vec2(CHROMATIC_ABERRATION_STRENGTH, 0)).b;
+    return color;
+}
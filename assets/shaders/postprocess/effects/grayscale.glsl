@@ -0,0 +1,7 @@
+// A per-pixel effect of the postprocess chain (see "source/common/systems/postprocess-chain.hpp")
+vec4 grayscale(vec4 color, vec2 uv){
+    // To apply the grayscale effect, we compute the average of the red/blue/green channels
+    // and set that average value to all the channels
+    float gray = dot(color.rgb, vec3(1.0/3.0, 1.0/3.0, 1.0/3.0));
+    return vec4(vec3(gray), color.a);
+}
@@ -0,0 +1,17 @@
+// A neighbourhood effect of the postprocess chain (see "source/common/systems/postprocess-chain.hpp")
+
+// The number of samples we read to compute the blurring effect
+#define RADIAL_BLUR_STEPS 16
+// The strength of the blurring effect
+#define RADIAL_BLUR_STRENGTH 0.2
+
+vec4 radial_blur(sampler2D source, vec2 uv){
+    // To apply radial blur, we compute the direction outward from the center to the current pixel
+    vec2 step_vector = (uv - 0.5) * (RADIAL_BLUR_STRENGTH / RADIAL_BLUR_STEPS);
+    // Then we sample multiple pixels along that direction and compute the average
+    vec4 color = vec4(0);
+    for(int i = 0; i < RADIAL_BLUR_STEPS; i++){
+        color += texture(source, uv + step_vector * i);
+    }
+    return color / RADIAL_BLUR_STEPS;
+}
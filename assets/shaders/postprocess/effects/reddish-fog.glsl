@@ -0,0 +1,11 @@
+// A per-pixel effect of the postprocess chain (see "source/common/systems/postprocess-chain.hpp")
+vec4 reddish_fog(vec4 color, vec2 uv){
+    // The fog factor grows from the bottom left corner of the screen to its top right corner
+    float fogFactor = uv.y /2+ uv.x / 2.5;
+
+    // Reddish fog color
+    vec3 fogColor = vec3(1.0, 0.3, 0.3);
+
+    // Mix the scene color with the fog color based on the fog factor
+    return vec4(mix(color.rgb, fogColor, fogFactor), 1.0);
+}
@@ -0,0 +1,18 @@
+// A per-pixel effect of the postprocess chain (see "source/common/systems/postprocess-chain.hpp")
+
+// A function to generate noise
+float reddish_noise_hash(vec2 uv) {
+    // Generate a random number based on the coordinates
+    return fract(sin(dot(uv, vec2(12, 78))) * 43758);
+}
+
+vec4 reddish_noise(vec4 color, vec2 uv){
+    // create red vector
+    vec4 red = vec4(color.r, color.g * 0.5, color.b * 0.5, color.a);
+
+    // Generate a random noise value based on the texture coordinates
+    float n = reddish_noise_hash(uv);
+
+    // Use the noise value to randomly alter the grayscale value of the pixel
+    return vec4(vec3(red + n * 0.15 - 0.1), color.a);
+}
@@ -0,0 +1,18 @@
+// A per-pixel effect of the postprocess chain (see "source/common/systems/postprocess-chain.hpp")
+
+// Vignette is a postprocessing effect that darkens the corners of the screen
+// to grab the attention of the viewer towards the center of the screen
+vec4 vignette(vec4 color, vec2 uv){
+    // To apply vignette, divide the scene color
+    // by 1 + the squared length of the 2D pixel location the NDC space
+    // The length function calculates the distance from the center of the NDC space (0, 0) to the transformed texture coordinate.
+    // This distance represents how far the current pixel is from the center.
+    // Squaring emphasizes the difference from the center and increases the effect towards the corners.
+    // Adding 1 ensures that the denominator is always greater than 1.
+
+    // To transform from texture coordinate space to NDC space, we can multiply by 2 and subtract 1
+    vec3 vignette_color = color.rgb / (1 + pow(length(uv * 2 - 1), 2));
+
+    // The alpha is set to 1
+    return vec4(vignette_color, 1);
+}
@@ -7,17 +7,9 @@ uniform sampler2D tex;
 in vec2 tex_coord;
 out vec4 frag_color;
 
-// The number of samples we read to compute the blurring effect
-#define STEPS 16
-// The strength of the blurring effect
-#define STRENGTH 0.2
+// The effect is shared with the postprocess chain which runs it in its own pass (since it samples the neighbouring pixels)
+#include "effects/radial-blur.glsl"
 
 void main(){
-    // To apply radial blur, we compute the direction outward from the center to the current pixel
-    vec2 step_vector = (tex_coord - 0.5) * (STRENGTH / STEPS);
-    // Then we sample multiple pixels along that direction and compute the average
-    for(int i = 0; i < STEPS; i++){
-        frag_color += texture(tex, tex_coord + step_vector * i);    
-    }
-    frag_color /= STEPS;
-}
\ No newline at end of file
+    frag_color = radial_blur(tex, tex_coord);
+}
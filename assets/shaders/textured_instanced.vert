@@ -0,0 +1,21 @@
+#version 330 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 tex_coord;
+// The object to world matrix of each instance is read from the instance buffer (it takes the locations 4 to 7)
+layout(location = 4) in mat4 objectToWorld;
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+} vs_out;
+
+// The view projection matrix is shared by all the instances
+uniform mat4 VP;
+
+void main(){
+    gl_Position = VP * objectToWorld * vec4(position, 1.0);
+    vs_out.color = color;
+    vs_out.tex_coord = tex_coord;
+}
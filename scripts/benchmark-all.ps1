@@ -0,0 +1,31 @@
+param([string[]] $tests, [int] $warmup = 60, [int] $frames = 300, [string] $context = "native")
+
+# Benchmarks every config under "config/" (or only the given groups, e.g. "mesh-test")
+# The results are written as JSON to "benchmarks/<group>/<config>.json" so that they can be compared between commits
+
+$failure = 0
+
+$configs = Get-ChildItem -Path "config" -Recurse -Filter "*.jsonc"
+foreach ($config in $configs) {
+    $group = Split-Path -Leaf $config.DirectoryName
+    if ($group -eq "config") { $group = "app" }
+    if (($tests.Count -ne 0) -and !($tests -contains $group)) { continue }
+
+    $path = Resolve-Path -Relative $config.FullName
+    $output = "benchmarks/$group/$($config.BaseName).json"
+    Write-Output "Benchmarking $path ..."
+    ./bin/GAME_APPLICATION --benchmark -c="$path" --warmup=$warmup -f=$frames --context=$context -o="$output"
+    if ($LASTEXITCODE -ne 0) {
+        Write-Output "FAILURE: $path"
+        $failure += 1
+    }
+}
+
+Write-Output ""
+if ($failure -eq 0) {
+    Write-Output "SUCCESS: All benchmarks finished"
+    exit 0
+} else {
+    Write-Output "FAILURE: $failure benchmarks failed"
+    exit 1
+}
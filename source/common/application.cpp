@@ -9,6 +9,8 @@
 #include <queue>
 #include <tuple>
 #include <filesystem>
+#include <cmath>
+#include <algorithm>
 
 #include <flags/flags.h>
 
@@ -23,6 +25,11 @@
 #endif
 
 #include "texture/screenshot.hpp"
+#include "asset-loader.hpp"
+#include "shader/program-cache.hpp"
+#include "mesh/mesh-utils.hpp"
+#include "profiler.hpp"
+#include "benchmark.hpp"
 
 int health = 2; // Global variable to store health
 
@@ -167,6 +174,16 @@ int our::Application::run(int run_for_frames) {
 
     auto win_config = getWindowConfiguration();             // Returns the WindowConfiguration current struct instance.
 
+    if(benchmarking){
+        // The benchmark renders to a hidden window, so it doesn't need a visible desktop
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        win_config.isFullscreen = false;
+        // The context can be created using EGL or OSMesa (e.g. Mesa llvmpipe) instead of the platform's native API
+        if(benchmarkSettings.contextApi == "egl") glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        else if(benchmarkSettings.contextApi == "osmesa") glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        run_for_frames = benchmarkSettings.warmupFrames + benchmarkSettings.measuredFrames;
+    }
+
     // Create a window with the given "WindowConfiguration" attributes.
     // If it should be fullscreen, monitor should point to one of the monitors (e.g. primary monitor), otherwise it should be null
     GLFWmonitor* monitor = win_config.isFullscreen ? glfwGetPrimaryMonitor() : nullptr;
@@ -181,6 +198,9 @@ int our::Application::run(int run_for_frames) {
 
     gladLoadGL(glfwGetProcAddress);         // Load the OpenGL functions from the driver
 
+    // The benchmark should not be limited by the display refresh rate
+    if(benchmarking) glfwSwapInterval(0);
+
     // Print information about the OpenGL context
     std::cout << "VENDOR          : " << glGetString(GL_VENDOR) << std::endl;
     std::cout << "RENDERER        : " << glGetString(GL_RENDERER) << std::endl;
@@ -219,7 +239,8 @@ int our::Application::run(int run_for_frames) {
         ScreenshotRequest, 
         std::vector<ScreenshotRequest>, 
         std::greater<ScreenshotRequest>> requested_screenshots;
-    if(auto& screenshots = app_config["screenshots"]; screenshots.is_object()) {
+    // The benchmark skips them since writing the images would add noise to the measured frames
+    if(auto& screenshots = app_config["screenshots"]; !benchmarking && screenshots.is_object()) {
         auto base_path = std::filesystem::path(screenshots.value("directory", "screenshots"));
         if(auto& requests = screenshots["requests"]; requests.is_array()) {
             for(auto& item : requests){
@@ -230,29 +251,79 @@ int our::Application::run(int run_for_frames) {
         }
     }
 
+    // The assets released by a state stay cached (so that the next states can reuse them) within this budget
+    if(app_config.contains("assetCacheBudgetMB"))
+        our::setAssetCacheBudget((size_t)app_config.value("assetCacheBudgetMB", 256) << 20);
+
+    // The layout in which the models are uploaded (see "VertexFormat")
+    if(app_config.contains("vertexFormat"))
+        our::mesh_utils::setVertexFormat(our::mesh_utils::parseVertexFormat(app_config.value("vertexFormat", "full")));
+
+    // Read the simulation rate
+    if(auto& simulation = app_config["simulation"]; simulation.is_object()){
+        tickRate = std::max(1.0, simulation.value("tickRate", tickRate));
+        maxUpdatesPerFrame = std::max(1, simulation.value("maxUpdatesPerFrame", maxUpdatesPerFrame));
+    }
+    const double fixed_delta_time = 1.0 / tickRate;
+
+    // The profiler needs the OpenGL context (for the GPU timer queries) and ImGui (for the overlay)
+    our::profiler::initialize(app_config.contains("profiler") ? app_config["profiler"] : nlohmann::json());
+    // The program cache needs the OpenGL context to check the supported binary formats & to identify the driver
+    our::program_cache::initialize(app_config.contains("programCache") ? app_config["programCache"] : nlohmann::json());
+
+    // Initializes a state and reports how long it took and how many of its shader programs were loaded from the program cache
+    auto initialize_state = [](State* state, const char* reason){
+        auto programs_before = our::program_cache::getStats();
+        double start = glfwGetTime();
+        state->onInitialize();
+        double milliseconds = (glfwGetTime() - start) * 1000.0;
+        auto programs = our::program_cache::getStats();
+        std::cout << reason << " \"" << state->getName() << "\" initialized in " << milliseconds << " ms (shader programs: "
+                  << programs.hits - programs_before.hits << " cached in " << programs.hitMilliseconds - programs_before.hitMilliseconds << " ms, "
+                  << programs.misses - programs_before.misses << " compiled in " << programs.missMilliseconds - programs_before.missMilliseconds << " ms)"
+                  << std::endl;
+    };
+
     // If a scene change was requested, apply it
     if(nextState) {
         currentState = nextState;
         nextState = nullptr;
     }
     // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
-    if(currentState) currentState->onInitialize();
+    if(currentState) initialize_state(currentState, "Startup: state");
 
     // The time at which the last frame started. But there was no frames yet, so we'll just pick the current time.
     double last_frame_time = glfwGetTime();
     int current_frame = 0;
+    // The simulated time that is yet to be consumed by the fixed rate updates
+    double accumulator = 0.0;
+    // Records the time of each phase of the frames (only used in the benchmark mode)
+    our::BenchmarkRecorder benchmark;
+    // The screenshots are read back & written in the background so that they don't stall the frames
+    our::ScreenshotWriter screenshot_writer;
 
     //Game loop
     while(!glfwWindowShouldClose(window)){
         if(run_for_frames != 0 && current_frame >= run_for_frames) break;
-        glfwPollEvents(); // Read all the user events and call relevant callbacks.
+        our::profiler::beginFrame();
+        if(benchmarking) benchmark.beginFrame(current_frame >= benchmarkSettings.warmupFrames);
+        {
+            PROFILE_SCOPE("Poll Events");
+            glfwPollEvents(); // Read all the user events and call relevant callbacks.
+        }
+        if(benchmarking) benchmark.lap(our::BenchmarkPhase::EVENTS);
 
         // Start a new ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        if(currentState) currentState->onImmediateGui(); // Call to run any required Immediate GUI.
+        {
+            PROFILE_SCOPE("Immediate GUI");
+            if(currentState) currentState->onImmediateGui(); // Call to run any required Immediate GUI.
+            // The profiler overlay shows the statistics of the previous frames
+            our::profiler::drawOverlay();
+        }
 
 
         // Create a window to display the score only if the game is running
@@ -290,6 +361,7 @@ int our::Application::run(int run_for_frames) {
 
         // Render the ImGui commands we called (this doesn't actually draw to the screen yet.
         ImGui::Render();
+        if(benchmarking) benchmark.lap(our::BenchmarkPhase::GUI);
 
         // Just in case ImGui changed the OpenGL viewport (the portion of the window to which we render the geometry),
         // we set it back to cover the whole window
@@ -299,16 +371,46 @@ int our::Application::run(int run_for_frames) {
         // Get the current time (the time at which we are starting the current frame).
         double current_frame_time = glfwGetTime();
 
-        // Call onDraw, in which we will draw the current frame, and send to it the time difference between the last and current frame
-        if(currentState) currentState->onDraw(current_frame_time - last_frame_time);
+        // In the benchmark mode, every frame simulates the same time step so that the runs are comparable
+        double delta_time = benchmarking ? benchmarkSettings.timestep : current_frame_time - last_frame_time;
         last_frame_time = current_frame_time; // Then update the last frame start time (this frame is now the last frame)
 
+        // Advance the simulation in fixed steps until it catches up with the elapsed time
+        // (If a step requests a state change, the old state is not simulated any further)
+        accumulator += delta_time;
+        int updates = 0;
+        while(accumulator >= fixed_delta_time && updates < maxUpdatesPerFrame && !nextState){
+            PROFILE_SCOPE("State::onUpdate");
+            if(currentState) currentState->onUpdate(fixed_delta_time);
+            accumulator -= fixed_delta_time;
+            ++updates;
+        }
+        // If we could not catch up, the remaining time is dropped (the game slows down instead of freezing)
+        if(accumulator >= fixed_delta_time) accumulator = std::fmod(accumulator, fixed_delta_time);
+        if(benchmarking) benchmark.lap(our::BenchmarkPhase::UPDATE);
+
+        // Call onDraw, in which we will draw the current frame, and send to it the time difference between the last and current frame
+        // Then call onRender with how far we are between the last two simulation steps
+        {
+            PROFILE_SCOPE("State::onDraw");
+            if(currentState) currentState->onDraw(delta_time);
+        }
+        {
+            PROFILE_SCOPE("State::onRender");
+            if(currentState) currentState->onRender(accumulator / fixed_delta_time);
+        }
+        if(benchmarking) benchmark.lap(our::BenchmarkPhase::DRAW);
+
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
         // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
         glDisable(GL_DEBUG_OUTPUT);
         glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+        {
+            PROFILE_SCOPE("ImGui Render");
+            PROFILE_GPU_SCOPE("ImGui Render");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+        }
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
         // Re-enable the debug messages
         glEnable(GL_DEBUG_OUTPUT);
@@ -318,48 +420,94 @@ int our::Application::run(int run_for_frames) {
         // If F12 is pressed, take a screenshot
         if(keyboard.justPressed(GLFW_KEY_F12)){
             glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
-            std::string path = default_screenshot_filepath();
-            if(our::screenshot_png(path)){
-                std::cout << "Screenshot saved to: " << path << std::endl;
-            } else {
-                std::cerr << "Failed to save a Screenshot" << std::endl;
-            }
+            screenshot_writer.request(default_screenshot_filepath());
         }
         // There are any requested screenshots, take them
         while(requested_screenshots.size()){ 
             if(const auto& request = requested_screenshots.top(); request.first == current_frame){
-                if(our::screenshot_png(request.second)){
-                    std::cout << "Screenshot saved to: " << request.second << std::endl;
-                } else {
-                    std::cerr << "Failed to save a screenshot to: " << request.second << std::endl;
-                }
+                screenshot_writer.request(request.second);
                 requested_screenshots.pop();
             } else break;
         }
+        // The screenshots requested in the previous frames are saved once the GPU is done with them
+        screenshot_writer.update();
+
+        // F3 toggles the profiler overlay and F4 captures a trace of the next frames
+        if(keyboard.justPressed(GLFW_KEY_F3)){
+            our::profiler::setOverlayVisible(!our::profiler::isOverlayVisible());
+        }
+        if(keyboard.justPressed(GLFW_KEY_F4)){
+            our::profiler::startCapture("profiles/trace-" + std::to_string(current_frame) + ".json", 120);
+        }
+
+        if(benchmarking) benchmark.lap(our::BenchmarkPhase::GUI_RENDER);
 
         // Swap the frame buffers
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("Swap Buffers");
+            glfwSwapBuffers(window);
+        }
+        if(benchmarking) benchmark.lap(our::BenchmarkPhase::SWAP);
 
         // Update the keyboard and mouse data
         keyboard.update();
         mouse.update();
 
         // If a scene change was requested, apply it
-        while(nextState){
-            // If a scene was already running, destroy it (not delete since we can go back to it later)
-            if(currentState) currentState->onDestroy();
-            // Switch scenes
-            currentState = nextState;
-            nextState = nullptr;
-            // Initialize the new scene
-            currentState->onInitialize();
+        {
+            PROFILE_SCOPE("State Change");
+            while(nextState){
+                // If a scene was already running, destroy it (not delete since we can go back to it later)
+                if(currentState) currentState->onDestroy();
+                // Switch scenes
+                currentState = nextState;
+                nextState = nullptr;
+                // Initialize the new scene
+                initialize_state(currentState, "State switch:");
+                // The new scene starts its simulation from scratch (and the loading time should not be simulated)
+                accumulator = 0.0;
+                last_frame_time = glfwGetTime();
+            }
         }
 
+        if(benchmarking){
+            benchmark.lap(our::BenchmarkPhase::STATE_CHANGE);
+            benchmark.endFrame();
+        }
+
+        our::profiler::endFrame();
         ++current_frame;
     }
 
+    // Report the benchmark results
+    int exit_code = 0;
+    if(benchmarking){
+        nlohmann::json report = benchmark.getReport(benchmarkSettings);
+        report["renderer"] = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        if(benchmarkSettings.outputPath.empty()){
+            std::cout << report.dump(4) << std::endl;
+        } else {
+            std::filesystem::path output_path(benchmarkSettings.outputPath);
+            std::error_code error;
+            if(output_path.has_parent_path()) std::filesystem::create_directories(output_path.parent_path(), error);
+            std::ofstream output(output_path);
+            if(output){
+                output << report.dump(4) << std::endl;
+                std::cout << "Benchmark results saved to: " << benchmarkSettings.outputPath << std::endl;
+            } else {
+                std::cerr << "Failed to save the benchmark results to: " << benchmarkSettings.outputPath << std::endl;
+                exit_code = -1;
+            }
+        }
+    }
+
     // Call for cleaning up
     if(currentState) currentState->onDestroy();
+    // Delete the cached assets and the profiler queries while the OpenGL context still exists
+    our::clearAllAssets();
+    our::profiler::shutdown();
+    // Finish writing the screenshots that are still in flight
+    screenshot_writer.shutdown();
 
     // Shutdown ImGui & destroy the context
     ImGui_ImplOpenGL3_Shutdown();
@@ -371,7 +519,7 @@ int our::Application::run(int run_for_frames) {
 
     // And finally terminate GLFW
     glfwTerminate();
-    return 0; // Good bye
+    return exit_code; // Good bye
 }
 
 // Sets-up the window callback functions from GLFW to our (Mouse/Keyboard) classes.
@@ -12,6 +12,7 @@
 
 #include "input/keyboard.hpp"
 #include "input/mouse.hpp"
+#include "benchmark.hpp"
 
 extern  int health ; // Global variable to store health
 namespace our {
@@ -34,7 +35,10 @@ namespace our {
     public:
         virtual void onInitialize(){}                   // Called once before the game loop.
         virtual void onImmediateGui(){}                 // Called every frame to draw the Immediate GUI (if any).
+        virtual void onUpdate(double /*fixedDeltaTime*/){} // Called at a fixed rate (zero or more times per frame) to advance the simulation by "fixedDeltaTime".
         virtual void onDraw(double deltaTime){}         // Called every frame in the game loop passing the time taken to draw the frame "Delta time".
+        virtual void onRender(double /*alpha*/){}       // Called every frame after onUpdate & onDraw. "alpha" (in [0, 1)) is how far the current time
+                                                        // is between the last two simulation steps, so the state can draw between them.
         virtual void onDestroy(){}                      // Called once after the game loop ends for house cleaning.
 
         virtual std::string getName() {return "";}    // Returns the name of the scene.
@@ -65,6 +69,15 @@ namespace our {
         State * currentState = nullptr;         // This will store the current scene that is being run
         State * nextState = nullptr;            // If it is requested to go to another scene, this will contain a pointer to that scene
 
+        // The simulation runs at a fixed rate: "onUpdate" is called as many times as needed to catch up with the elapsed time.
+        // To avoid a spiral of death when a frame is very slow, at most "maxUpdatesPerFrame" steps are run per frame.
+        // They can be changed from the config using "simulation": {"tickRate": ..., "maxUpdatesPerFrame": ...}
+        double tickRate = 60.0;
+        int maxUpdatesPerFrame = 5;
+
+        bool benchmarking = false;              // If true, "run" runs the benchmark described by "benchmarkSettings"
+        BenchmarkSettings benchmarkSettings;
+
         
         // Virtual functions to be overrode and change the default behaviour of the application
         // according to the example needs.
@@ -82,6 +95,12 @@ namespace our {
         // This is the main class function that run the whole application (Initialize, Game loop, House cleaning).
         int run(int run_for_frames = 0);
 
+        // Makes "run" benchmark the start scene instead of running interactively (run_for_frames is then ignored)
+        void setBenchmark(const BenchmarkSettings& settings){
+            benchmarking = true;
+            benchmarkSettings = settings;
+        }
+
         // Register a state for use by the application
         // The state is uniquely identified by its name
         // If the name is already used, the old name owner is deleted and the new state takes its place
@@ -8,23 +8,107 @@
 #include "mesh/mesh-utils.hpp"
 #include "material/material.hpp"
 #include "deserialize-utils.hpp"
+#include "thread-pool.hpp"
+#include "profiler.hpp"
+
+#include <chrono>
+#include <iomanip>
 
 namespace our {
 
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        double millisecondsSince(Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        // The result of decoding an asset on a worker thread and the time it took
+        template<typename Data>
+        struct Decoded {
+            Data data;
+            double milliseconds = 0;
+        };
+
+        // The key of a decoded texture (the same image is decoded separately for each color space since its baked mip levels differ)
+        std::string getSourceKey(const texture_utils::TextureSource& source) {
+            return source.colorSpace == texture_utils::ColorSpace::SRGB ? source.path + " (srgb)" : source.path;
+        }
+
+        Decoded<texture_utils::ImageData> decodeImage(const texture_utils::TextureSource& source) {
+            auto start = Clock::now();
+            Decoded<texture_utils::ImageData> decoded;
+            decoded.data = texture_utils::decodeImage(source.path, true, source.colorSpace);
+            decoded.milliseconds = millisecondsSince(start);
+            return decoded;
+        }
+
+        // A mesh is given by its path which is also the key of the decoded mesh
+        std::string parseMeshSource(const nlohmann::json& desc) {
+            return desc.is_string() ? desc.get<std::string>() : std::string();
+        }
+        const std::string& getSourceKey(const std::string& path) {
+            return path;
+        }
+
+        // The mesh data is only valid if "loaded" is true
+        struct DecodedMesh {
+            mesh_utils::MeshData mesh;
+            bool loaded = false;
+        };
+
+        Decoded<DecodedMesh> decodeMesh(const std::string& path) {
+            auto start = Clock::now();
+            Decoded<DecodedMesh> decoded;
+            decoded.data.loaded = mesh_utils::decodeOBJ(path, decoded.data.mesh);
+            decoded.milliseconds = millisecondsSince(start);
+            return decoded;
+        }
+
+        // The decode jobs started by "deserializeAllAssets" keyed by their sources (see "getSourceKey").
+        // The deserialize functions take their results from here instead of decoding the files themselves.
+        std::unordered_map<std::string, std::shared_future<Decoded<texture_utils::ImageData>>> pendingImages;
+        std::unordered_map<std::string, std::shared_future<Decoded<DecodedMesh>>> pendingMeshes;
+
+        // The timings of the assets loaded by the last call to "deserializeAllAssets"
+        std::vector<AssetLoadTiming> loadTimings;
+    }
+
     // This will load all the shaders defined in "data"
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
+    // A shader can optionally define "instanced_vs" which is a vertex shader that reads the object transforms
+    // from instance attributes. It is linked with the same fragment shader into the instanced variant of the shader.
+    // A shader can also define "defines" which is an object of macros injected into all its stages: { "NAME" : value, ... }
     template<>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string vsPath = desc.value("vs", "");
                 std::string fsPath = desc.value("fs", "");
-                auto shader = new ShaderProgram();
-                shader->attach(vsPath, GL_VERTEX_SHADER);
-                shader->attach(fsPath, GL_FRAGMENT_SHADER);
-                shader->link();
-                assets[name] = shader;
+                std::string instancedVsPath = desc.value("instanced_vs", "");
+                ShaderDefines defines;
+                if(auto it = desc.find("defines"); it != desc.end() && it->is_object())
+                    for(auto& [macro, value] : it->items())
+                        defines.emplace_back(macro, value.is_string() ? value.get<std::string>() : value.dump());
+                acquire(name, desc.dump(), [&](size_t&){
+                    auto start = Clock::now();
+                    auto shader = new ShaderProgram();
+                    for(auto& [macro, value] : defines) shader->define(macro, value);
+                    shader->attach(vsPath, GL_VERTEX_SHADER);
+                    shader->attach(fsPath, GL_FRAGMENT_SHADER);
+                    shader->link();
+                    if(!instancedVsPath.empty()){
+                        auto variant = new ShaderProgram();
+                        for(auto& [macro, value] : defines) variant->define(macro, value);
+                        variant->attach(instancedVsPath, GL_VERTEX_SHADER);
+                        variant->attach(fsPath, GL_FRAGMENT_SHADER);
+                        variant->link();
+                        shader->setInstancedVariant(variant);
+                    }
+                    loadTimings.push_back({"shader", name, 0, millisecondsSince(start)});
+                    return shader;
+                });
             }
         }
     };
@@ -32,12 +116,27 @@ namespace our {
     // This will load all the textures defined in "data"
     // data must be in the form:
     //    { texture_name : "path/to/image", ... }
+    // A texture holding sRGB colors (e.g. an albedo map) can be given as { "path": "path/to/image", "colorSpace": "srgb" }
+    // so that its baked mip levels are filtered in linear space (see "texture_utils::ColorSpace")
     template<>
     void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                std::string path = desc.get<std::string>();
-                assets[name] = texture_utils::loadImage(path);
+                texture_utils::TextureSource source = texture_utils::parseTextureSource(desc);
+                std::string key = getSourceKey(source);
+                acquire(name, key, [&](size_t& byteSize){
+                    // Use the image decoded by a worker if there is one, otherwise decode it now
+                    Decoded<texture_utils::ImageData> local;
+                    const Decoded<texture_utils::ImageData>* image = &local;
+                    if(auto it = pendingImages.find(key); it != pendingImages.end()) image = &it->second.get();
+                    else local = decodeImage(source);
+
+                    auto start = Clock::now();
+                    Texture2D* texture = image->data.isLoaded() ? texture_utils::uploadImage(image->data) : nullptr;
+                    loadTimings.push_back({"texture", name, image->milliseconds, millisecondsSince(start)});
+                    if(texture) byteSize = texture->getByteSize();
+                    return texture;
+                });
             }
         }
     };
@@ -53,9 +152,11 @@ namespace our {
     void AssetLoader<Sampler>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                auto sampler = new Sampler();
-                sampler->deserialize(desc);
-                assets[name] = sampler;
+                acquire(name, desc.dump(), [&](size_t&){
+                    auto sampler = new Sampler();
+                    sampler->deserialize(desc);
+                    return sampler;
+                });
             }
         }
     };
@@ -68,7 +169,19 @@ namespace our {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
-                assets[name] = mesh_utils::loadOBJ(path);
+                acquire(name, path, [&](size_t& byteSize){
+                    // Use the mesh decoded by a worker if there is one, otherwise decode it now
+                    Decoded<DecodedMesh> local;
+                    const Decoded<DecodedMesh>* decoded = &local;
+                    if(auto it = pendingMeshes.find(path); it != pendingMeshes.end()) decoded = &it->second.get();
+                    else local = decodeMesh(path);
+
+                    auto start = Clock::now();
+                    Mesh* mesh = decoded->data.loaded ? mesh_utils::uploadMesh(decoded->data.mesh) : nullptr;
+                    loadTimings.push_back({"mesh", name, decoded->milliseconds, millisecondsSince(start)});
+                    if(mesh) byteSize = mesh->getByteSize();
+                    return mesh;
+                });
             }
         }
     };
@@ -89,16 +202,44 @@ namespace our {
     void AssetLoader<Material>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                std::string type = desc.value("type", "");
-                auto material = createMaterialFromType(type);
-                material->deserialize(desc);
-                assets[name] = material;
+                acquire(name, desc.dump(), [&](size_t&){
+                    std::string type = desc.value("type", "");
+                    auto material = createMaterialFromType(type);
+                    material->deserialize(desc);
+                    return material;
+                });
             }
         }
     };
 
+    // The maximum number of bytes that the unreferenced assets can occupy
+    static size_t assetCacheBudget = 256ull << 20;
+
     void deserializeAllAssets(const nlohmann::json& assetData){
         if(!assetData.is_object()) return;
+        PROFILE_SCOPE("deserializeAllAssets");
+        auto start = Clock::now();
+        loadTimings.clear();
+        // The materials hold pointers to shaders, textures and samplers which could have been evicted or replaced since
+        // the materials were released. Since materials are cheap to create, the unreferenced ones are never reused.
+        AssetLoader<Material>::evict();
+
+        // Start decoding the textures and the meshes that are not resident on the worker threads
+        // so that they are decoded while the shaders are compiled on this thread
+        std::unique_ptr<ThreadPool> pool;
+        auto prefetch = [&](const char* key, auto& pending, auto parse, auto decode, auto isResident){
+            if(!assetData.contains(key) || !assetData[key].is_object()) return;
+            for(auto& [name, desc] : assetData[key].items()){
+                auto source = parse(desc);
+                std::string sourceKey = getSourceKey(source);
+                if(sourceKey.empty() || isResident(name, sourceKey) || pending.count(sourceKey)) continue;
+                if(!pool) pool = std::make_unique<ThreadPool>();
+                pending[sourceKey] = pool->submit([source, decode]{ return decode(source); }).share();
+            }
+        };
+        prefetch("textures", pendingImages, texture_utils::parseTextureSource, decodeImage, AssetLoader<Texture2D>::isResident);
+        prefetch("meshes", pendingMeshes, parseMeshSource, decodeMesh, AssetLoader<Mesh>::isResident);
+
         if(assetData.contains("shaders"))
             AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
         if(assetData.contains("textures"))
@@ -109,6 +250,77 @@ namespace our {
             AssetLoader<Mesh>::deserialize(assetData["meshes"]);
         if(assetData.contains("materials"))
             AssetLoader<Material>::deserialize(assetData["materials"]);
+
+        // All the decoded data has been uploaded, so it can be freed
+        pendingImages.clear();
+        pendingMeshes.clear();
+
+        // Report the assets that were actually loaded (the resident ones took no time)
+        if(!loadTimings.empty()){
+            std::cout << std::fixed << std::setprecision(2);
+            for(auto& timing : loadTimings){
+                std::cout << "Loaded " << timing.type << " \"" << timing.name << "\": decode " << timing.decodeMilliseconds
+                          << " ms, upload " << timing.uploadMilliseconds << " ms" << std::endl;
+            }
+            std::cout << "Loaded " << loadTimings.size() << " assets in " << millisecondsSince(start) << " ms"
+                      << " (using " << (pool ? pool->getThreadCount() : 0) << " worker threads)" << std::endl;
+            std::cout << std::defaultfloat;
+        }
+    }
+
+    const std::vector<AssetLoadTiming>& getAssetLoadTimings(){
+        return loadTimings;
+    }
+
+    void releaseAllAssets(const nlohmann::json& assetData){
+        if(!assetData.is_object()) return;
+        if(assetData.contains("materials"))
+            AssetLoader<Material>::release(assetData["materials"]);
+        if(assetData.contains("shaders"))
+            AssetLoader<ShaderProgram>::release(assetData["shaders"]);
+        if(assetData.contains("textures"))
+            AssetLoader<Texture2D>::release(assetData["textures"]);
+        if(assetData.contains("samplers"))
+            AssetLoader<Sampler>::release(assetData["samplers"]);
+        if(assetData.contains("meshes"))
+            AssetLoader<Mesh>::release(assetData["meshes"]);
+        trimAssetCache();
+    }
+
+    void setAssetCacheBudget(size_t bytes){
+        assetCacheBudget = bytes;
+        trimAssetCache();
+    }
+
+    void trimAssetCache(){
+        // A budget of 0 means that nothing is cached (including the assets whose size is unknown such as shaders)
+        if(assetCacheBudget == 0){
+            AssetLoader<Material>::evict();
+            AssetLoader<ShaderProgram>::evict();
+            AssetLoader<Texture2D>::evict();
+            AssetLoader<Sampler>::evict();
+            AssetLoader<Mesh>::evict();
+            return;
+        }
+        auto unreferencedBytes = [](){
+            return AssetLoader<ShaderProgram>::getUnreferencedBytes() + AssetLoader<Texture2D>::getUnreferencedBytes() +
+                   AssetLoader<Sampler>::getUnreferencedBytes() + AssetLoader<Mesh>::getUnreferencedBytes();
+        };
+        if(unreferencedBytes() <= assetCacheBudget) return;
+        // The unreferenced materials may point to the assets we are about to evict, so they go first
+        AssetLoader<Material>::evict();
+        while(unreferencedBytes() > assetCacheBudget){
+            // Find the least recently used unreferenced asset among all the types and evict it
+            uint64_t oldest = std::min({
+                AssetLoader<ShaderProgram>::getOldestUnreferencedUse(), AssetLoader<Texture2D>::getOldestUnreferencedUse(),
+                AssetLoader<Sampler>::getOldestUnreferencedUse(), AssetLoader<Mesh>::getOldestUnreferencedUse()
+            });
+            if(oldest == UINT64_MAX) break;
+            AssetLoader<ShaderProgram>::evict(oldest);
+            AssetLoader<Texture2D>::evict(oldest);
+            AssetLoader<Sampler>::evict(oldest);
+            AssetLoader<Mesh>::evict(oldest);
+        }
     }
 
     void clearAllAssets(){
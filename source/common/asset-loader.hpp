@@ -2,50 +2,166 @@
 
 #include <unordered_map>
 #include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 #include <json/json.hpp>
 
 namespace our {
 
+    // Every asset access (load or reuse) gets a stamp from this counter. It is used to evict the least recently used assets first.
+    inline uint64_t assetUseCounter = 0;
+
     // This static template class will hold the loaded assets
     // and can be called from anywhere to get an asset by its name.
     // Since we have different types of assets, this declared as a template class
     // and for each asset type, we define a specialization in "asset-loader.cpp"
+    // The assets are reference counted: each state that deserializes an asset holds a reference to it until it releases it.
+    // An asset that is no longer referenced stays resident so that the next state that asks for it gets it instantly.
+    // Unreferenced assets are only deleted by "evict" (which is driven by the memory budget, see "trimAssetCache") or "clear".
     template<typename T>
     class AssetLoader {
-        // This map stores a pointer to each asset identified by its name
+        // The cached data of each asset
+        struct Entry {
+            T* asset = nullptr;
+            std::string source;     // A description of where the asset came from (e.g. the file path). If a name is deserialized
+                                    // again with a different source, the old asset is replaced instead of being reused.
+            size_t references = 0;  // The number of states currently using the asset
+            size_t byteSize = 0;    // An estimate of the memory used by the asset
+            uint64_t lastUse = 0;   // The value of "assetUseCounter" when the asset was last acquired or released
+        };
+        // This map stores each asset identified by its name
         // All assets in this map are owned by the asset loader so it should not be deleted outside of this class
-        static inline std::unordered_map<std::string, T*> assets;
+        static inline std::unordered_map<std::string, Entry> assets;
+
+        // Returns the asset with the given name if it is resident and came from the same source, otherwise it creates it
+        // using "load" which receives a reference to the asset byte size that it should fill. In both cases, a reference is added.
+        template<typename Loader>
+        static T* acquire(const std::string& name, const std::string& source, Loader&& load) {
+            if(auto it = assets.find(name); it != assets.end()){
+                Entry& entry = it->second;
+                entry.lastUse = ++assetUseCounter;
+                if(entry.source == source || entry.references > 0){
+                    // An asset that is still in use can not be replaced, so the existing one is shared
+                    if(entry.source != source)
+                        std::cerr << "Asset \"" << name << "\" is already loaded from another source and is still in use" << std::endl;
+                    entry.references++;
+                    return entry.asset;
+                }
+                // The name now refers to another source and nobody uses the old asset, so we replace it
+                delete entry.asset;
+                assets.erase(it);
+            }
+            Entry entry;
+            entry.source = source;
+            entry.asset = load(entry.byteSize);
+            entry.references = 1;
+            entry.lastUse = ++assetUseCounter;
+            T* asset = entry.asset;
+            assets.emplace(name, entry);
+            return asset;
+        }
     public:
         // This function loads the assets defined by the given json object
         // The json object should be defined in the form: {asset_name: asset_description}
         // For example: {"white": "textures/white.png", "polka": "textures/polka.png"} defines 2 textures
         // where the key will be asset name and the description holds the path to the texture file
+        // Assets that are already resident (with the same description) are reused and only get an extra reference
         static void deserialize(const nlohmann::json&);
+        // This function releases the references acquired by "deserialize" for the assets defined by the given json object
+        // The assets are not deleted, they stay resident until they are evicted (see "evict")
+        static void release(const nlohmann::json& data) {
+            if(!data.is_object()) return;
+            for(auto& [name, desc] : data.items()){
+                if(auto it = assets.find(name); it != assets.end() && it->second.references > 0){
+                    it->second.references--;
+                    it->second.lastUse = ++assetUseCounter;
+                }
+            }
+        }
         // This function find an asset by its name and returns a pointer to it
         // If no asset with the given name was found, the function returns a nullptr
         // WARNING: never delete the asset returned by the function.
         // The asset could be shared with another object and
         // all the assets will be automatically cleared when the function "clear" is called
+        // Returns true if deserializing the given name with the given source would reuse a resident asset instead of loading it
+        static bool isResident(const std::string& name, const std::string& source) {
+            auto it = assets.find(name);
+            return it != assets.end() && (it->second.source == source || it->second.references > 0);
+        }
         static T* get(const std::string& name) {
             if(auto it = assets.find(name); it != assets.end()){
-                return it->second;
+                return it->second.asset;
             }
             return nullptr;
         };
+        // Returns the total estimated size of all the resident assets
+        static size_t getResidentBytes() {
+            size_t total = 0;
+            for(auto& [name, entry] : assets) total += entry.byteSize;
+            return total;
+        }
+        // Returns the total estimated size of the resident assets that are no longer referenced
+        static size_t getUnreferencedBytes() {
+            size_t total = 0;
+            for(auto& [name, entry] : assets) if(entry.references == 0) total += entry.byteSize;
+            return total;
+        }
+        // Returns the last use stamp of the least recently used unreferenced asset (or UINT64_MAX if there is none)
+        static uint64_t getOldestUnreferencedUse() {
+            uint64_t oldest = UINT64_MAX;
+            for(auto& [name, entry] : assets) if(entry.references == 0) oldest = std::min(oldest, entry.lastUse);
+            return oldest;
+        }
+        // Deletes the unreferenced assets that were last used at or before the given stamp and returns the number of freed bytes
+        // Calling it with UINT64_MAX deletes all the unreferenced assets
+        static size_t evict(uint64_t lastUse = UINT64_MAX) {
+            size_t freed = 0;
+            for(auto it = assets.begin(); it != assets.end();){
+                if(it->second.references == 0 && it->second.lastUse <= lastUse){
+                    freed += it->second.byteSize;
+                    delete it->second.asset;
+                    it = assets.erase(it);
+                } else it++;
+            }
+            return freed;
+        }
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
-            for(auto& [name, asset] : assets){
-                delete asset;
+            for(auto& [name, entry] : assets){
+                delete entry.asset;
             }
             assets.clear();
         }
     };
 
+    // The time spent loading an asset: "decode" is the time spent on a worker thread (decoding an image or parsing a model)
+    // and "upload" is the time spent on the OpenGL thread (creating the OpenGL objects)
+    struct AssetLoadTiming {
+        std::string type, name;
+        double decodeMilliseconds = 0, uploadMilliseconds = 0;
+    };
+
     // Given a json holding the data for all the assets
     // This function will call "AssetLoader<T>::deserialize" for all the different asset types T
     // For example, a json in the form {"shaders": ... , "textures": ... } will call "deserialize" for:
     // AssetLoader<ShaderProgram> and AssetLoader<Texture2D>
+    // The textures and the meshes that are not resident are decoded on worker threads while the shaders are compiled,
+    // then the OpenGL objects are created on the calling thread in the order: shaders, textures, samplers, meshes & materials
     void deserializeAllAssets(const nlohmann::json& assetData);
+    // Returns the timings of the assets loaded by the last call to "deserializeAllAssets" (resident assets are not included)
+    const std::vector<AssetLoadTiming>& getAssetLoadTimings();
+    // This will call "AssetLoader<T>::release" for all the different asset types T
+    // It should be given the same json that was given to "deserializeAllAssets". The released assets stay resident
+    // (so the next state can reuse them) until the unreferenced assets exceed the cache budget (see "trimAssetCache").
+    void releaseAllAssets(const nlohmann::json& assetData);
+    // Sets the maximum number of bytes that the unreferenced assets can occupy (the default is 256 MB)
+    // A budget of 0 means that the assets are deleted as soon as they are released
+    void setAssetCacheBudget(size_t bytes);
+    // Evicts the least recently used unreferenced assets until they fit in the cache budget
+    void trimAssetCache();
     // This will call "AssetLoader<T>::clear" for all the different asset types T
+    // WARNING this deletes the assets even if they are still referenced, so it should only be called when no state uses them
     void clearAllAssets();
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    namespace {
+
+        const char* PHASE_NAMES[(int)BenchmarkPhase::COUNT + 1] = {
+            "events", "gui", "update", "draw", "gui_render", "swap", "state_change", "frame"
+        };
+
+        // Returns the given percentile of the sorted samples (nearest rank)
+        double percentile(const std::vector<double>& sorted, double fraction) {
+            size_t index = std::min(sorted.size() - 1, (size_t)(fraction * (sorted.size() - 1) + 0.5));
+            return sorted[index];
+        }
+
+        nlohmann::json summarize(std::vector<double> samples) {
+            if(samples.empty()) return nullptr;
+            std::sort(samples.begin(), samples.end());
+            double sum = 0;
+            for(double sample : samples) sum += sample;
+            return {
+                {"min", samples.front()},
+                {"mean", sum / samples.size()},
+                {"p50", percentile(samples, 0.50)},
+                {"p95", percentile(samples, 0.95)},
+                {"p99", percentile(samples, 0.99)},
+                {"max", samples.back()}
+            };
+        }
+
+    }
+
+    nlohmann::json BenchmarkRecorder::getReport(const BenchmarkSettings& settings) const {
+        nlohmann::json phases = nlohmann::json::object();
+        for(int phase = 0; phase <= (int)BenchmarkPhase::COUNT; phase++)
+            phases[PHASE_NAMES[phase]] = summarize(samples[phase]);
+        return {
+            {"config", settings.configName},
+            {"warmupFrames", settings.warmupFrames},
+            {"measuredFrames", samples[(int)BenchmarkPhase::COUNT].size()},
+            {"timestep", settings.timestep},
+            {"unit", "ms"},
+            {"phases", phases}
+        };
+    }
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // The settings of the benchmark mode (see "Application::setBenchmark").
+    // In the benchmark mode, the application runs in a hidden window with vsync disabled, every frame receives
+    // the same simulated time step, and the CPU time of each phase of the frame is recorded then reported as JSON.
+    struct BenchmarkSettings {
+        int warmupFrames = 60;          // The frames run before measuring (to let the caches & the driver settle)
+        int measuredFrames = 300;       // The frames whose timings are reported
+        double timestep = 1.0 / 60.0;   // The time passed to every frame instead of the wall clock delta time
+        std::string contextApi = "native"; // The API used to create the context: "native", "egl" or "osmesa"
+        std::string outputPath;         // Where the JSON report is written (if empty, it is printed to the standard output)
+        std::string configName;         // Copied to the report to identify the run
+    };
+
+    // The phases of a frame (in the order they run in "Application::run")
+    enum class BenchmarkPhase {
+        EVENTS,         // Polling the window events
+        GUI,            // Building the immediate GUI
+        UPDATE,         // The state's fixed rate onUpdate steps (simulation)
+        DRAW,           // The state's onDraw & onRender (rendering)
+        GUI_RENDER,     // Rendering the immediate GUI
+        SWAP,           // Swapping the buffers (this is where the CPU waits if the GPU is behind)
+        STATE_CHANGE,   // Applying the requested state changes
+        COUNT
+    };
+
+    // Records the CPU time of every phase of the measured frames.
+    // Each call to "lap" ends the given phase and starts the next one, so the phases cover the whole frame.
+    class BenchmarkRecorder {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point frameStart, lapStart;
+        bool measuring = false;
+        // The samples (in milliseconds) of each phase followed by the samples of the whole frame
+        std::vector<double> samples[(int)BenchmarkPhase::COUNT + 1];
+
+    public:
+        // Starts a frame. The frame is only recorded if "measure" is true (e.g. it is not a warm-up frame).
+        void beginFrame(bool measure) {
+            measuring = measure;
+            frameStart = lapStart = Clock::now();
+        }
+
+        // Ends the given phase
+        void lap(BenchmarkPhase phase) {
+            if(!measuring) return;
+            auto now = Clock::now();
+            samples[(int)phase].push_back(std::chrono::duration<double, std::milli>(now - lapStart).count());
+            lapStart = now;
+        }
+
+        void endFrame() {
+            if(!measuring) return;
+            samples[(int)BenchmarkPhase::COUNT].push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+        }
+
+        // Returns the report: the settings followed by the min, mean, p50, p95, p99 & max time (in ms) of each phase and of the whole frame
+        nlohmann::json getReport(const BenchmarkSettings& settings) const;
+    };
+
+}
@@ -20,9 +20,9 @@ namespace our {
     }
 
     // Creates and returns the camera view matrix
-    glm::mat4 CameraComponent::getViewMatrix() const {
+    glm::mat4 CameraComponent::getViewMatrix(float alpha) const {
         auto owner = getOwner();
-        auto M = owner->getLocalToWorldMatrix();
+        auto M = owner->getInterpolatedLocalToWorldMatrix(alpha);
         //Done: (Req 8) Complete this function
         //HINT:
         // In the camera space:
@@ -28,7 +28,8 @@ namespace our {
         void deserialize(const nlohmann::json& data) override;
 
         // Creates and returns the camera view matrix
-        glm::mat4 getViewMatrix() const;
+        // "alpha" selects a transform between the owner's previous and current transforms (see "Entity::getInterpolatedLocalToWorldMatrix")
+        glm::mat4 getViewMatrix(float alpha = 1.0f) const;
         
         // Creates and returns the camera projection matrix
         // "viewportSize" is used to compute the aspect ratio
@@ -1,4 +1,5 @@
 #include "collider.hpp"
+#include "../systems/spatial-hash.hpp"
 
 namespace our
 {
@@ -10,4 +11,10 @@ namespace our
         Radius = data.value("Radius", 1.0f);
     }
 
-}
\ No newline at end of file
+    // Unregister the collider from the broadphase grid (if it is registered in one)
+    Collider::~Collider()
+    {
+        if(grid) grid->remove(this);
+    }
+
+}
@@ -3,16 +3,32 @@
 #include "../ecs/component.hpp"
 #include "../asset-loader.hpp"
 
+#include <glm/glm.hpp>
+
 // #include "light.hpp"  // CHECK
 
 namespace our {
+
+    class SpatialHash; // A forward declaration of the SpatialHash class (see "systems/spatial-hash.hpp")
+
     class Collider : public Component {
     public:
         float Radius;
+
+        // The following data is maintained by the collider system's broadphase and should not be modified elsewhere
+        glm::vec3 center = {0, 0, 0};        // The world space center of the collider (computed once per frame)
+        glm::ivec3 cellMin = {0, 0, 0};      // The range of grid cells in which this collider is registered
+        glm::ivec3 cellMax = {0, 0, 0};
+        SpatialHash* grid = nullptr;         // The grid in which this collider is registered (if any)
+        unsigned int queryStamp = 0;         // Used by the grid to report each candidate once per query
+
         static std::string getID() { return "Collider"; }
 
         // Receives the mesh & material from the AssetLoader by the names given in the json object
         void deserialize(const nlohmann::json& data) override;
+
+        // When a collider is deleted, it removes itself from the grid so that the grid never holds a dangling pointer
+        ~Collider() override;
     };
 
 }
@@ -2,10 +2,25 @@
 
 #include <json/json.hpp>
 #include <string>
+#include <cstddef>
 
 namespace our {
 
     class Entity; // A forward declaration of the Entity Class
+    class World; // A forward declaration of the World Class
+
+    namespace internal {
+        // The next free component type id (see "getComponentTypeId")
+        inline size_t nextComponentTypeId = 0;
+    }
+
+    // Returns a small unique number for each component type. The ids are assigned the first time each type is used.
+    // They are used instead of RTTI to find the components of a certain type inside an entity and in the world's pools.
+    template<typename T>
+    size_t getComponentTypeId() {
+        static const size_t id = internal::nextComponentTypeId++;
+        return id;
+    }
 
     // A component is a data container that can be added to an entity.
     // The role of the entity in the world is defined by the components it holds.
@@ -13,7 +28,10 @@ namespace our {
     // Thus any renderer system should look for an entity holding a camera component in order to compute the camera related uniforms (e.g. VP matrix)
     class Component {
         Entity* owner; // A pointer to the entity that owns this component
+        size_t typeId = 0; // The type id of the concrete component type (set by "Entity::addComponent")
+        size_t poolIndex = 0; // The index of this component inside the world's pool of its type
         friend Entity; // The entity is a friend since it is the only one allowed to set itself as an owner of a certain component.
+        friend World; // The world is a friend since it maintains the component pools
     public:
         // This static method returns a unique string that identifies each type of components
         // This ID will be used as the key to store a component into the entity's component map 
@@ -1,4 +1,5 @@
 #include "entity.hpp"
+#include "world.hpp"
 #include "../deserialize-utils.hpp"
 #include "../components/component-deserializer.hpp"
 
@@ -6,30 +7,129 @@
 
 namespace our {
 
+    // This function returns the transformation matrix from the entity's local space to its parent's space
+    // The matrix is only recomputed if "localTransform" was modified since the last call (or if it was marked dirty)
+    const glm::mat4& Entity::getLocalMatrix() const {
+        if(transformDirty || localTransform != cachedTransform){
+            localMatrix = localTransform.toMat4();
+            cachedTransform = localTransform;
+            transformDirty = false;
+            // The world matrix notices the change through the version when it is requested
+            ++localVersion;
+        }
+        return localMatrix;
+    }
+
     // This function returns the transformation matrix from the entity's local space to the world space
     // Remember that you can get the transformation matrix from this entity to its parent from "localTransform"
     // To get the local to world matrix, you need to combine this entities matrix with its parent's matrix and
     // its parent's parent's matrix and so on till you reach the root.
-    glm::mat4 Entity::getLocalToWorldMatrix() const {
+    // The result is cached, so the matrices are only multiplied when this entity or one of its ancestors changed.
+    // The ancestors are still checked on every call since their transforms may have been modified since the last one.
+    const glm::mat4& Entity::getLocalToWorldMatrix() const {
         //Done: (Req 8) Write this function
 
-        // Create a 4D transformation matrix from this entity and its parent 
-        glm::mat4 localToWorldMatrix = this->localTransform.toMat4();
+        // The parent's world matrix is validated first (which recursively validates all the ancestors)
+        if(this->parent != nullptr) this->parent->getLocalToWorldMatrix();
+        return refreshWorldMatrix();
+    }
+
+    // This function recomputes the world matrix if the local matrix, the parent or the parent's world matrix changed
+    // since it was computed. It expects the parent's world matrix to be up to date.
+    const glm::mat4& Entity::refreshWorldMatrix() const {
+        // Make sure the local matrix is up to date (this bumps "localVersion" if it changed)
+        const glm::mat4& local = getLocalMatrix();
+        bool dirty = !worldValid || worldLocalVersion != localVersion || cachedParent != this->parent;
 
-        // Looping over the parents of this entity till we reach the root multiply the transformation matrices from the right
-        // Parent * Child
         if(this->parent != nullptr){
-            localToWorldMatrix = this->parent->getLocalToWorldMatrix() * localToWorldMatrix;
+            // Parent * Child
+            if(dirty || parentVersion != this->parent->worldVersion){
+                worldMatrix = this->parent->worldMatrix * local;
+                parentVersion = this->parent->worldVersion;
+                dirty = true;
+            }
+        } else if(dirty) {
+            // A root entity's world matrix is its local matrix
+            worldMatrix = local;
         }
 
-        return localToWorldMatrix;
+        if(dirty){
+            worldValid = true;
+            worldLocalVersion = localVersion;
+            cachedParent = this->parent;
+            ++worldVersion;
+        }
+        return worldMatrix;
+    }
+
+    // This function validates the world matrix as part of the given pass of "World::updateTransforms".
+    // An entity that was already validated in this pass (as the ancestor of an entity visited before it) returns at once,
+    // so each entity is checked once per pass no matter how deep it is.
+    void Entity::validateWorldMatrix(unsigned int pass) const {
+        if(validatedPass == pass) return;
+        if(this->parent != nullptr) this->parent->validateWorldMatrix(pass);
+        refreshWorldMatrix();
+        validatedPass = pass;
+    }
+
+    // This function returns the local to world matrix between the previous and the current transforms
+    // If nothing moved in the chain of ancestors, this is the cached local to world matrix
+    glm::mat4 Entity::getInterpolatedLocalToWorldMatrix(float alpha) const {
+        glm::mat4 matrix;
+        interpolateLocalToWorldMatrix(alpha, matrix);
+        return matrix;
+    }
+
+    // This function writes the interpolated local to world matrix and returns true if the entity or one of its ancestors moves.
+    // Each level tells its child whether the chain above it moves, so the ancestors are walked once (instead of once per level
+    // with "isMoving"), and a chain that doesn't move only reads the cached matrices (which it refreshes on the way down).
+    bool Entity::interpolateLocalToWorldMatrix(float alpha, glm::mat4& matrix) const {
+        glm::mat4 parentMatrix(1.0f);
+        bool parentMoving = this->parent != nullptr && this->parent->interpolateLocalToWorldMatrix(alpha, parentMatrix);
+        // The parent's world matrix was refreshed by its call, so this one can be refreshed without walking the ancestors again
+        const glm::mat4& world = refreshWorldMatrix();
+        bool moving = previousTransform != localTransform;
+        if(!moving && !parentMoving){
+            matrix = world;
+            return false;
+        }
+        glm::mat4 local = moving ? Transform::interpolate(previousTransform, localTransform, alpha) : getLocalMatrix();
+        matrix = parentMatrix * local;
+        return true;
+    }
+
+    // Adds the component to the pool of its type in the world that owns this entity
+    void Entity::registerComponent(Component *component){
+        if(world) world->registerComponent(component);
+    }
+
+    // Removes the component from the pool of its type in the world that owns this entity
+    void Entity::unregisterComponent(Component *component){
+        if(world) world->unregisterComponent(component);
+    }
+
+    // Removes the component at the given index from the world's pools and from the components list then deletes it
+    void Entity::destroyComponent(size_t index){
+        Component* component = components[index];
+        unregisterComponent(component);
+        components.erase(components.begin() + index);
+        delete component;
     }
 
     // Deserializes the entity data and components from a json object
     void Entity::deserialize(const nlohmann::json& data){
         if(!data.is_object()) return;
+        // The name & the tags are indexed by the world, so the entity is indexed again once they are read
+        if(world) world->unindexEntity(this);
         name = data.value("name", name);
+        if(const auto& tagsData = data.value("tags", nlohmann::json()); tagsData.is_array()){
+            for(const auto& tag : tagsData)
+                if(tag.is_string()) tags.push_back(internName(tag.get<std::string>()));
+        }
+        if(world) world->indexEntity(this);
         localTransform.deserialize(data);
+        // The entity did not move yet
+        previousTransform = localTransform;
         if(data.contains("components")){
             if(const auto& components = data["components"]; components.is_array()){
                 for(auto& component: components){
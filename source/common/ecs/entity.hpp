@@ -2,9 +2,10 @@
 
 #include "component.hpp"
 #include "transform.hpp"
-#include <list>
-#include <iterator>
+#include "name-id.hpp"
+#include <vector>
 #include <string>
+#include <algorithm>
 #include <glm/glm.hpp>
 
 namespace our
@@ -14,20 +15,69 @@ namespace our
 
     class Entity
     {
-        World *world;                      // This defines what world own this entity
-        std::list<Component *> components; // A list of components that are owned by this entity
+        World *world = nullptr;              // This defines what world own this entity
+        std::vector<Component *> components; // A list of components that are owned by this entity
+        std::string name;                    // The name of the entity. It could be useful to refer to an entity by its name
+                                             // The world indexes the entities by their names, so it is changed by "World::rename"
+        NameId nameId = NO_NAME;             // The interned "name" (kept in sync by the world, see "World::rename")
+        std::vector<NameId> tags;            // The interned tags of the entity (read from the "tags" array of the entity's json)
+
+        // The transformation matrices are cached and only recomputed when they become dirty.
+        // The local matrix is dirty when "localTransform" differs from the transform it was computed from.
+        // The world matrix is dirty when the local matrix changed since it was computed (its "localVersion" differs)
+        // or when the parent's world matrix changed, which is detected by comparing the parent's version with the version
+        // seen during the last update. Thus a change in an entity invalidates all of its descendants without having to visit them.
+        // The two caches are tracked separately, so the getters can be called in any order.
+        mutable Transform cachedTransform;              // The transform from which "localMatrix" was computed
+        mutable glm::mat4 localMatrix = glm::mat4(1.0f);  // The cached transformation from the local space to the parent space
+        mutable glm::mat4 worldMatrix = glm::mat4(1.0f);  // The cached transformation from the local space to the world space
+        mutable unsigned int localVersion = 0;          // Incremented every time "localMatrix" changes
+        mutable bool worldValid = false;                // False until "worldMatrix" is computed for the first time
+        mutable unsigned int worldLocalVersion = 0;     // The "localVersion" when "worldMatrix" was computed
+        mutable const Entity *cachedParent = nullptr;   // The parent used to compute "worldMatrix"
+        mutable unsigned int parentVersion = 0;         // The parent's "worldVersion" when "worldMatrix" was computed
+        mutable unsigned int worldVersion = 0;          // Incremented every time "worldMatrix" changes
+        mutable bool transformDirty = true;             // Forces the local matrix to be recomputed on the next access
+        mutable unsigned int validatedPass = 0;         // The last pass of "World::updateTransforms" that validated "worldMatrix"
 
         friend World;       // The world is a friend since it is the only class that is allowed to instantiate an entity
         Entity() = default; // The entity constructor is private since only the world is allowed to instantiate an entity
+
+        // These add/remove a component to/from the pool of its type in the world (see "World::view")
+        // They are defined in "entity.cpp" since the world is only forward declared here
+        void registerComponent(Component *component);
+        void unregisterComponent(Component *component);
+        // Removes the component at the given index from the world's pools and from the components list then deletes it
+        void destroyComponent(size_t index);
+        // Recomputes the world matrix if it is dirty. The parent's world matrix must already be up to date.
+        const glm::mat4 &refreshWorldMatrix() const;
+        // Validates the world matrix once per pass of "World::updateTransforms" (the ancestors are validated first
+        // unless this pass already validated them)
+        void validateWorldMatrix(unsigned int pass) const;
+        // Writes the interpolated local to world matrix (see "getInterpolatedLocalToWorldMatrix") and returns true if the
+        // entity or one of its ancestors moves
+        bool interpolateLocalToWorldMatrix(float alpha, glm::mat4 &matrix) const;
     public:
-        std::string name;         // The name of the entity. It could be useful to refer to an entity by its name
-        Entity *parent;           // The parent of the entity. The transform of the entity is relative to its parent.
+        Entity *parent = nullptr; // The parent of the entity. The transform of the entity is relative to its parent.
                                   // If parent is null, the entity is a root entity (has no parent).
         Transform localTransform; // The transform of this entity relative to its parent.
+        Transform previousTransform; // The local transform at the start of the last simulation step (see "World::storePreviousTransforms").
+                                     // The renderer draws the entity between it and "localTransform" to hide the fixed simulation rate.
 
         World *getWorld() const { return world; } // Returns the world to which this entity belongs
-
-        glm::mat4 getLocalToWorldMatrix() const;  // Computes and returns the transformation from the entities local space to the world space
+        const std::string &getName() const { return name; } // Returns the name of the entity (use "World::rename" to change it)
+        NameId getNameId() const { return nameId; } // Returns the interned name (comparing ids is cheaper than comparing strings)
+        const std::vector<NameId> &getTags() const { return tags; } // Returns the interned tags of the entity
+        bool hasTag(NameId tag) const { return std::find(tags.begin(), tags.end(), tag) != tags.end(); }
+
+        const glm::mat4 &getLocalToWorldMatrix() const; // Returns the (cached) transformation from the entities local space to the world space
+        const glm::mat4 &getLocalMatrix() const;        // Returns the (cached) transformation from the entities local space to its parent space
+        void markTransformDirty() { transformDirty = true; } // Forces the cached matrices to be recomputed on the next access
+        // Returns the transformation from the entities local space to the world space "alpha" of the way between
+        // the previous and the current transforms of the entity and its ancestors (alpha=1 is the current transform)
+        glm::mat4 getInterpolatedLocalToWorldMatrix(float alpha) const;
+        // Returns true if the entity or one of its ancestors moved during the last simulation step
+        bool isMoving() const { return previousTransform != localTransform || (parent && parent->isMoving()); }
         void deserialize(const nlohmann::json &); // Deserializes the entity data and components from a json object
 
         // This template method create a component of type T,
@@ -42,8 +92,11 @@ namespace our
             T *component = new T();
             // Making the owner of the component to be this entity pointer on component parent to pointer (this) that represents this entity
             component->owner = this;
-            // Pushing the component into the component's list
+            // The type id is stored so that the component can be found without a dynamic_cast
+            component->typeId = getComponentTypeId<T>();
+            // Pushing the component into the component's list and into the world's pool of its type
             components.push_back(component);
+            registerComponent(component);
 
             // Don't forget to return a pointer to the new component
             return component;
@@ -51,33 +104,32 @@ namespace our
 
         // This template method searhes for a component of type T and returns a pointer to it
         // If no component of type T was found, it returns a nullptr
+        // The components are matched by their type id, so T must be the exact type of the component (as passed to addComponent)
         template <typename T>
         T *getComponent()
         {
-            // Done: (Req 8) Go through the components list and find the first component that can be dynamically cast to "T*".
+            // Done: (Req 8) Go through the components list and find the first component of type "T".
             //  Return the component you found, or return null of nothing was found.
 
-            // Looping over the components list
-            // Checking if the component can be dynamically cast to "T*"
-            for (auto it = components.begin(); it != components.end(); it++)
+            // An entity only has a few components, so a linear search over their type ids is cheap
+            const size_t typeId = getComponentTypeId<T>();
+            for (auto component : components)
             {
-                if (dynamic_cast<T *>(*it) != nullptr)
+                if (component->typeId == typeId)
                 {
-                    return dynamic_cast<T *>(*it);
+                    return static_cast<T *>(component);
                 }
             }
             return nullptr;
         }
 
-        // This template method dynami and returns a pointer to it
-        // If no component of type T was found, it returns a nullptr
+        // This template method returns the component at the given index if it is of type T
+        // If the index is out of range or the component is not of type T, it returns a nullptr
         template <typename T>
         T *getComponent(size_t index)
         {
-            auto it = components.begin();
-            std::advance(it, index);
-            if (it != components.end())
-                return dynamic_cast<T *>(*it);
+            if (index < components.size() && components[index]->typeId == getComponentTypeId<T>())
+                return static_cast<T *>(components[index]);
             return nullptr;
         }
 
@@ -85,29 +137,24 @@ namespace our
         template <typename T>
         void deleteComponent()
         {
-            // Done: (Req 8) Go through the components list and find the first component that can be dynamically cast to "T*".
+            // Done: (Req 8) Go through the components list and find the first component of type "T".
             //  If found, delete the found component and remove it from the components list
-             for (auto it = components.begin(); it != components.end(); it++)
+            const size_t typeId = getComponentTypeId<T>();
+            for (size_t index = 0; index < components.size(); index++)
             {
-                if (dynamic_cast<T *>(*it) != nullptr)
+                if (components[index]->typeId == typeId)
                 {
-                    delete *it;
-                    components.erase(it);
+                    destroyComponent(index);
                     break;
                 }
             }
         }
 
-        // This template method searhes for a component of type T and deletes it
+        // This method deletes the component at the given index
         void deleteComponent(size_t index)
         {
-            auto it = components.begin();
-            std::advance(it, index);
-            if (it != components.end())
-            {
-                delete *it;
-                components.erase(it);
-            }
+            if (index < components.size())
+                destroyComponent(index);
         }
 
         // This template method searhes for the given component and deletes it
@@ -116,12 +163,11 @@ namespace our
         {
             // Done: (Req 8) Go through the components list and find the given component "component".
             //  If found, delete the found component and remove it from the components list
-            for (auto it = components.begin(); it != components.end(); it++)
+            for (size_t index = 0; index < components.size(); index++)
             {
-                if (*it == component)
+                if (components[index] == component)
                 {
-                    delete *it;
-                    components.erase(it);
+                    destroyComponent(index);
                     break;
                 }
             }
@@ -131,9 +177,10 @@ namespace our
         ~Entity()
         {
             // Done: (Req 8) Delete all the components in "components".
-            for (auto it = components.begin(); it != components.end(); it++)
+            for (auto component : components)
             {
-                delete *it;
+                unregisterComponent(component);
+                delete component;
             }
 
             // Don't forget to clear the components list
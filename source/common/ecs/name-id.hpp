@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace our {
+
+    // An interned name: every distinct string is given a small id the first time it is seen.
+    // So names can be compared in O(1) and used as indices (see "World::findByName").
+    using NameId = uint32_t;
+
+    // The id of the empty name (entities without a name or tags are not indexed)
+    constexpr NameId NO_NAME = 0;
+
+    namespace internal {
+        // The interned names. The id of a name is its index in "names"
+        inline std::unordered_map<std::string, NameId> nameIds = {{"", NO_NAME}};
+        inline std::vector<std::string> names = {""};
+    }
+
+    // Returns the id of the given name (a new id is given to a name that was never seen)
+    // Like the component type ids, the names should only be interned from the main thread
+    inline NameId internName(const std::string& name) {
+        auto it = internal::nameIds.find(name);
+        if(it != internal::nameIds.end()) return it->second;
+        NameId id = (NameId)internal::names.size();
+        internal::names.push_back(name);
+        internal::nameIds.emplace(name, id);
+        return id;
+    }
+
+    // Returns the id of the given name or NO_NAME if it was never interned (unlike "internName", it never adds a name)
+    // Queries use it so that looking up an unknown name doesn't grow the table
+    inline NameId findName(const std::string& name) {
+        auto it = internal::nameIds.find(name);
+        return it != internal::nameIds.end() ? it->second : NO_NAME;
+    }
+
+    // Returns the string of an interned name
+    inline const std::string& getInternedName(NameId id) {
+        return internal::names[id];
+    }
+
+}
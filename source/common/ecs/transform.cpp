@@ -2,6 +2,7 @@
 #include "../deserialize-utils.hpp"
 
 #include <glm/gtx/euler_angles.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 namespace our {
 
@@ -23,6 +24,16 @@ namespace our {
         return translationM * rotationM * scaleM;
     }
 
+    // Computes the matrix of the transform that is "t" of the way between "from" and "to"
+    glm::mat4 Transform::interpolate(const Transform& from, const Transform& to, float t) {
+        glm::quat fromRotation = glm::quat_cast(glm::yawPitchRoll(from.rotation.y, from.rotation.x, from.rotation.z));
+        glm::quat toRotation = glm::quat_cast(glm::yawPitchRoll(to.rotation.y, to.rotation.x, to.rotation.z));
+        glm::mat4 scaleM = glm::scale(glm::mat4(1.0f), glm::mix(from.scale, to.scale, t));
+        glm::mat4 rotationM = glm::mat4_cast(glm::slerp(fromRotation, toRotation, t));
+        glm::mat4 translationM = glm::translate(glm::mat4(1.0f), glm::mix(from.position, to.position, t));
+        return translationM * rotationM * scaleM;
+    }
+
      // Deserializes the entity data and components from a json object
     void Transform::deserialize(const nlohmann::json& data){
         position = data.value("position", position);
@@ -14,8 +14,19 @@ namespace our {
 
         // This function computes and returns a matrix that represents this transform
         glm::mat4 toMat4() const;
+        // Computes the matrix of the transform that is "t" of the way between "from" (t=0) and "to" (t=1)
+        // The position & scale are interpolated linearly and the rotation is interpolated spherically
+        // (so a rotation that wraps around 2*PI doesn't spin the other way)
+        static glm::mat4 interpolate(const Transform& from, const Transform& to, float t);
          // Deserializes the entity data and components from a json object
         void deserialize(const nlohmann::json&);
+
+        // Two transforms are equal if they have the same position, rotation and scale
+        // This is used by the entity to detect whether its cached matrices are still valid
+        bool operator==(const Transform& other) const {
+            return position == other.position && rotation == other.rotation && scale == other.scale;
+        }
+        bool operator!=(const Transform& other) const { return !(*this == other); }
     };
 
 }
\ No newline at end of file
@@ -12,7 +12,7 @@ namespace our {
 
             Entity* entity = add();              // Create an entity
             entity->parent = parent;             // Make its parent "parent"
-            entity->deserialize(entityData);     // Call its deserialize with "entityData"
+            entity->deserialize(entityData);     // Call its deserialize with "entityData" (which indexes it by its name & tags)
             
             // If the entity data contains children, call this function recursively for each child
             if(entityData.contains("children")){
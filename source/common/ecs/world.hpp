@@ -1,15 +1,124 @@
 #pragma once
 
 #include <unordered_set>
+#include <vector>
+#include <deque>
+#include <tuple>
+#include <algorithm>
 #include "entity.hpp"
+#include "../profiler.hpp"
 
 namespace our {
 
+    // A view iterates over the entities that have all the components T, Others... (see "World::view")
+    // It walks the smallest of the component pools, so its cost is proportional to the number of matching candidates
+    // instead of the number of entities. Each step yields a tuple of component pointers that can be unpacked using
+    // a structured binding:
+    //    for(auto [renderer, collider] : world->view<MeshRendererComponent, Collider>()) { ... }
+    // WARNING Components must not be added or deleted while iterating over a view (entities should be marked for removal instead)
+    template<typename T, typename... Others>
+    class View {
+        const std::vector<Component*>* pool; // The pool driving the iteration
+
+    public:
+        class Iterator {
+            const std::vector<Component*>* pool;
+            size_t index;
+
+            // Returns true if the owner of the given component has all the requested components
+            static bool matches(const Component* component) {
+                if constexpr (sizeof...(Others) == 0) return true;
+                else {
+                    Entity* entity = component->getOwner();
+                    return entity->getComponent<T>() && (entity->getComponent<Others>() && ...);
+                }
+            }
+            // Skips the components whose owners do not have all the requested components
+            void skip() {
+                while(index < pool->size() && !matches((*pool)[index])) index++;
+            }
+        public:
+            Iterator(const std::vector<Component*>* pool, size_t index) : pool(pool), index(index) { skip(); }
+
+            std::tuple<T*, Others*...> operator*() const {
+                Component* component = (*pool)[index];
+                if constexpr (sizeof...(Others) == 0) return {static_cast<T*>(component)};
+                else {
+                    Entity* entity = component->getOwner();
+                    return {entity->getComponent<T>(), entity->getComponent<Others>()...};
+                }
+            }
+            Iterator& operator++() { index++; skip(); return *this; }
+            bool operator==(const Iterator& other) const { return index == other.index; }
+            bool operator!=(const Iterator& other) const { return index != other.index; }
+        };
+
+        explicit View(const std::vector<Component*>* pool) : pool(pool) {}
+
+        Iterator begin() const { return Iterator(pool, 0); }
+        Iterator end() const { return Iterator(pool, pool->size()); }
+    };
+
     // This class holds a set of entities
     class World {
         std::unordered_set<Entity*> entities; // These are the entities held by this world
         std::unordered_set<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
                                                       // when deleteMarkedEntities is called
+        // The components of each type are stored densely in the pool indexed by their type id (see "getComponentTypeId")
+        // A deque is used so that the pools never move when a pool for a new type is created
+        std::deque<std::vector<Component*>> pools;
+        // The entities having each name or tag, indexed by the interned name (see "findByName")
+        std::vector<std::vector<Entity*>> nameIndex;
+        // The number of passes of "updateTransforms" (each entity remembers the last pass that validated it)
+        unsigned int transformPass = 0;
+
+        friend Entity; // The entity is a friend since it adds and removes its components to/from the pools
+
+        // Returns the pool of the given component type id (creating it if needed)
+        std::vector<Component*>& getPool(size_t typeId) {
+            while(pools.size() <= typeId) pools.emplace_back();
+            return pools[typeId];
+        }
+        // Appends the component to the pool of its type
+        void registerComponent(Component* component) {
+            auto& pool = getPool(component->typeId);
+            component->poolIndex = pool.size();
+            pool.push_back(component);
+        }
+        // Adds the entity to the index under its name and its tags
+        void indexEntity(Entity* entity) {
+            entity->nameId = internName(entity->name);
+            auto addTo = [&](NameId id){
+                if(id == NO_NAME) return;
+                if(nameIndex.size() <= id) nameIndex.resize(id + 1);
+                nameIndex[id].push_back(entity);
+            };
+            addTo(entity->nameId);
+            for(NameId tag : entity->tags) addTo(tag);
+        }
+        // Removes the entity from the index
+        void unindexEntity(Entity* entity) {
+            auto removeFrom = [&](NameId id){
+                if(id == NO_NAME || id >= nameIndex.size()) return;
+                auto& entities = nameIndex[id];
+                auto it = std::find(entities.begin(), entities.end(), entity);
+                if(it == entities.end()) return;
+                *it = entities.back();
+                entities.pop_back();
+            };
+            removeFrom(entity->nameId);
+            for(NameId tag : entity->tags) removeFrom(tag);
+        }
+        // Removes the component from the pool of its type by moving the last component of the pool into its place
+        void unregisterComponent(Component* component) {
+            if(component->typeId >= pools.size()) return;
+            auto& pool = pools[component->typeId];
+            if(component->poolIndex >= pool.size() || pool[component->poolIndex] != component) return;
+            Component* last = pool.back();
+            pool[component->poolIndex] = last;
+            last->poolIndex = component->poolIndex;
+            pool.pop_back();
+        }
     public:
 
         World() = default;
@@ -33,16 +142,87 @@ namespace our {
             // Set its world member variable to this and add it to the entities set
             entity->world = this;
             entities.insert(entity);
-            
+            // Then index it (it has no name yet, so it only shows up in "findByName" once it is renamed or deserialized)
+            indexEntity(entity);
+
             // Return a pointer to the new entity
             return entity;
         }
 
+        // This returns the entities having the given name or tag in O(1). The order of the entities is not specified.
+        // The string overloads don't intern the name, so looking up a name that no entity ever had finds nothing.
+        const std::vector<Entity*>& getEntitiesByName(NameId name) const {
+            static const std::vector<Entity*> none;
+            return name < nameIndex.size() ? nameIndex[name] : none;
+        }
+        const std::vector<Entity*>& getEntitiesByName(const std::string& name) const {
+            return getEntitiesByName(findName(name));
+        }
+
+        // This returns an entity having the given name or tag (or null if there is none)
+        Entity* findByName(NameId name) const {
+            const auto& entities = getEntitiesByName(name);
+            return entities.empty() ? nullptr : entities.front();
+        }
+        Entity* findByName(const std::string& name) const {
+            return findByName(findName(name));
+        }
+
+        // This returns the number of entities having the given name or tag (including the ones marked for removal)
+        size_t countByName(NameId name) const {
+            return getEntitiesByName(name).size();
+        }
+        size_t countByName(const std::string& name) const {
+            return countByName(findName(name));
+        }
+
+        // This changes the name of the entity and updates the index (the name of an entity can only be changed through here)
+        void rename(Entity* entity, const std::string& name) {
+            unindexEntity(entity);
+            entity->name = name;
+            indexEntity(entity);
+        }
+
         // This returns and immutable reference to the set of all entites in the world.
         const std::unordered_set<Entity*>& getEntities() {
             return entities;
         }
 
+        // This returns a view over the entities having all the components T, Others... (see "View")
+        template<typename T, typename... Others>
+        View<T, Others...> view() {
+            // Iterate over the smallest pool since every matching entity must have a component in each pool
+            const size_t typeIds[] = {getComponentTypeId<T>(), getComponentTypeId<Others>()...};
+            const std::vector<Component*>* smallest = &getPool(typeIds[0]);
+            for(size_t typeId : typeIds){
+                const std::vector<Component*>* pool = &getPool(typeId);
+                if(pool->size() < smallest->size()) smallest = pool;
+            }
+            return View<T, Others...>(smallest);
+        }
+
+        // This remembers the current transform of every entity as its previous transform.
+        // Call it at the start of every simulation step so that the renderer can interpolate between the last two steps.
+        void storePreviousTransforms() {
+            for (auto entity : entities) {
+                entity->previousTransform = entity->localTransform;
+            }
+        }
+
+        // This validates the cached local to world matrices of all the entities in a single pass.
+        // Every entity validates its ancestors first, but an entity already validated in this pass is skipped and each matrix
+        // is only recomputed if it is dirty, so the pass is linear in the number of entities. Call it once per step after the
+        // systems that move entities: the later calls to "getLocalToWorldMatrix" still check the ancestors (since they may
+        // have moved since), but they only multiply matrices for the entities that changed after the pass.
+        void updateTransforms() {
+            PROFILE_SCOPE("World::updateTransforms");
+            // The pass numbers start at 1 since 0 is the pass of the entities that were never validated
+            if(++transformPass == 0) ++transformPass;
+            for (auto entity : entities) {
+                entity->validateWorldMatrix(transformPass);
+            }
+        }
+
         // This marks an entity for removal by adding it to the "markedForRemoval" set.
         // The elements in the "markedForRemoval" set will be removed and deleted when "deleteMarkedEntities" is called.
         void markForRemoval(Entity* entity){
@@ -52,11 +232,17 @@ namespace our {
             }
         }
 
+        // This returns true if the entity is waiting in the "markedForRemoval" set to be deleted.
+        bool isMarkedForRemoval(Entity* entity) const {
+            return markedForRemoval.find(entity) != markedForRemoval.end();
+        }
+
         // This removes the elements in "markedForRemoval" from the "entities" set.
         // Then each of these elements are deleted.
         void deleteMarkedEntities(){
             //DONE (Req 8) Remove and delete all the entities that have been marked for removal
             for (auto entity : markedForRemoval) {
+                unindexEntity(entity);          // Remove the entity from the name index
                 entities.erase(entity);         // Remove the entity from the entities set
                 delete entity;                  // Delete the entity
             }
@@ -66,11 +252,13 @@ namespace our {
         //This deletes all entities in the world
         void clear(){
             //DONE (Req 8) Delete all the entites and make sure that the containers are empty
+            pools.clear();                      // The pools are cleared first so that the entities don't remove their components one by one
             for (auto entity : entities) {
                 delete entity;
             }
             entities.clear();                   // Remove all the entities from the entities set 
             markedForRemoval.clear();           // Remove all the entities from the markedForRemoval set
+            nameIndex.clear();                  // Forget all the names
         }
 
         //Since the world owns all of its entities, they should be deleted alongside it.
@@ -0,0 +1,58 @@
+#include "mapped-file.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace our {
+
+#if defined(_WIN32)
+
+    MappedFile::MappedFile(const std::string& path) {
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(handle == INVALID_HANDLE_VALUE) return;
+        file = handle;
+        LARGE_INTEGER fileSize;
+        // An empty file can not be mapped, so we treat it as a failure
+        if(!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) return;
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping == nullptr) return;
+        content = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if(content) length = (size_t)fileSize.QuadPart;
+    }
+
+    MappedFile::~MappedFile() {
+        if(content) UnmapViewOfFile(content);
+        if(mapping) CloseHandle(mapping);
+        if(file) CloseHandle(file);
+    }
+
+#else
+
+    MappedFile::MappedFile(const std::string& path) {
+        file = open(path.c_str(), O_RDONLY);
+        if(file < 0) return;
+        struct stat info;
+        // An empty file can not be mapped, so we treat it as a failure
+        if(fstat(file, &info) != 0 || info.st_size == 0) return;
+        void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if(address == MAP_FAILED) return;
+        content = static_cast<const uint8_t*>(address);
+        length = (size_t)info.st_size;
+    }
+
+    MappedFile::~MappedFile() {
+        if(content) munmap(const_cast<uint8_t*>(content), length);
+        if(file >= 0) close(file);
+    }
+
+#endif
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace our {
+
+    // This class maps a whole file into memory for reading.
+    // The file content can be read directly from "data()" (e.g. to pass it to glBufferData) without copying it into a buffer.
+    // The mapping is released when the object is destroyed.
+    class MappedFile {
+        const uint8_t* content = nullptr; // The address at which the file is mapped (nullptr if the file could not be mapped)
+        size_t length = 0;                // The size of the file in bytes
+#if defined(_WIN32)
+        void* file = nullptr;             // The file & file mapping handles
+        void* mapping = nullptr;
+#else
+        int file = -1;                    // The file descriptor
+#endif
+    public:
+        // Maps the file found at the given path. Use "isOpen" to check whether it succeeded.
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        // Returns true if the file was mapped successfully
+        bool isOpen() const { return content != nullptr; }
+        // Returns a pointer to the file content and its size
+        const uint8_t* data() const { return content; }
+        size_t size() const { return length; }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+}
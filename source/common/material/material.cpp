@@ -10,11 +10,12 @@ namespace our {
         //DONE (Req 7) Write this function
         pipelineState.setup(); // Setup the pipeline state that was implemented in pipeline-state.hpp
         shader->use();         // Use the shader that was implemented in shader.hpp
+        setupUniforms(shader); // Send the uniforms of the derived material types
     }
 
-    void LitMaterial::setup() const 
+    void LitMaterial::setupUniforms(ShaderProgram* program) const 
     {
-        Material::setup();
+        Material::setupUniforms(program);
 
         /*TODO (req Light): SEND NEEDED DATA TO SHADER*/
     }
@@ -43,28 +44,28 @@ namespace our {
         transparent = data.value("transparent", false);
     }
 
-    void TintedMaterial::setup() const {
+    void TintedMaterial::setupUniforms(ShaderProgram* program) const {
         //DONE (Req 7) Write this function        
-        // Call the setup function of the parent class
-        Material::setup();               
+        // Call the setupUniforms function of the parent class
+        Material::setupUniforms(program);               
         
         // Set the "tint" uniform to the value in the member variable tint. 
         // This is done by calling the set function of vec4 type of the shader class 
-        shader->set("tint", tint);     
+        program->set("tint", tint);     
 
     }
 
-    void LitTintedMaterial::setup() const 
+    void LitTintedMaterial::setupUniforms(ShaderProgram* program) const 
     {
-        LitMaterial::setup();
+        LitMaterial::setupUniforms(program);
 
         /*TODO (req Light): SEND NEEDED DATA TO SHADER*/
-        shader->set("material.diffuse", glm::vec3(albedo_tint.r, albedo_tint.g, albedo_tint.b));
-        shader->set("material.specular", glm::vec3(specular.r, specular.g, specular.b));
-        shader->set("material.ambient", glm::vec3(ambient.r, ambient.g, ambient.b));
-        shader->set("material.emissive", glm::vec3(emissive_tint.r, emissive_tint.g, emissive_tint.b));
-        shader->set("material.shininess", shininess);
-        shader->set("alpha", ambient.a);
+        program->set("material.diffuse", glm::vec3(albedo_tint.r, albedo_tint.g, albedo_tint.b));
+        program->set("material.specular", glm::vec3(specular.r, specular.g, specular.b));
+        program->set("material.ambient", glm::vec3(ambient.r, ambient.g, ambient.b));
+        program->set("material.emissive", glm::vec3(emissive_tint.r, emissive_tint.g, emissive_tint.b));
+        program->set("material.shininess", shininess);
+        program->set("alpha", ambient.a);
     }
 
     void LitTintedMaterial::deserialize(const nlohmann::json& data)
@@ -83,15 +84,15 @@ namespace our {
         tint = data.value("tint", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
     }
 
-    void TexturedMaterial::setup() const {
+    void TexturedMaterial::setupUniforms(ShaderProgram* program) const {
         //DONE (Req 7) Write this function
 
-        // Call the setup function of the parent class
-        TintedMaterial::setup();
+        // Call the setupUniforms function of the parent class
+        TintedMaterial::setupUniforms(program);
 
         // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
         // This is done by calling the set function of float type of the shader class
-        shader->set("alphaThreshold", alphaThreshold);
+        program->set("alphaThreshold", alphaThreshold);
 
         // Activate the texture unit which will be used to bind the texture and sampler to it
         // void glActiveTexture(GLenum texture);
@@ -120,7 +121,7 @@ namespace our {
 
         // Set the "tex" uniform to the value of the texture unit number
         // This is done by calling the set function of int type of the shader class
-        shader->set("tex", 0);
+        program->set("tex", 0);
     }
 
     // This function read the material data from a json object
@@ -132,16 +133,16 @@ namespace our {
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
     }
 
-    void LitTexturedMaterial::setup() const 
+    void LitTexturedMaterial::setupUniforms(ShaderProgram* program) const 
     {
-        LitTintedMaterial::setup();
+        LitTintedMaterial::setupUniforms(program);
 
         /*TODO (req Light): SEND NEEDED DATA TO SHADER*/
-        shader->set("tex_material.roughness_range", roughness_range);
-        shader->set("tex_material.albedo_tint", glm::vec3(albedo_tint.r, albedo_tint.g, albedo_tint.b));
-        shader->set("tex_material.specular_tint", glm::vec3(specular_tint.r, specular_tint.g, specular_tint.b));
-        shader->set("tex_material.emissive_tint", glm::vec3(emissive_tint.r, emissive_tint.g, emissive_tint.b));
-        shader->set("alphaThreshold", alphaThreshold); // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
+        program->set("tex_material.roughness_range", roughness_range);
+        program->set("tex_material.albedo_tint", glm::vec3(albedo_tint.r, albedo_tint.g, albedo_tint.b));
+        program->set("tex_material.specular_tint", glm::vec3(specular_tint.r, specular_tint.g, specular_tint.b));
+        program->set("tex_material.emissive_tint", glm::vec3(emissive_tint.r, emissive_tint.g, emissive_tint.b));
+        program->set("alphaThreshold", alphaThreshold); // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
         //Specifies which texture unit to make active
         glActiveTexture(GL_TEXTURE0);
         if (albedo_map)
@@ -160,7 +161,7 @@ namespace our {
         {
             Sampler::unbind(0); //if null unbind
         }
-        shader->set("tex_material.albedo_map", 0);
+        program->set("tex_material.albedo_map", 0);
         //Specifies which texture unit to make active
         glActiveTexture(GL_TEXTURE0 + 1);
         if (specular_map)
@@ -179,7 +180,7 @@ namespace our {
         {
             Sampler::unbind(1); //if null unbind
         }
-        shader->set("tex_material.specular_map", 1);
+        program->set("tex_material.specular_map", 1);
         //Specifies which texture unit to make active
         glActiveTexture(GL_TEXTURE0 + 2);
         if (ambient_occlusion_map)
@@ -194,7 +195,7 @@ namespace our {
             ambient_occlusion_sampler->bind(2); // check if sampler is not null then bind it
         else
             Sampler::unbind(2); //if null unbind
-        shader->set("tex_material.ambient_occlusion_map", 2);
+        program->set("tex_material.ambient_occlusion_map", 2);
         //Specifies which texture unit to make active
         glActiveTexture(GL_TEXTURE0 + 3);
         if (roughness_map)
@@ -207,7 +208,7 @@ namespace our {
             roughness_sampler->bind(3); // check if sampler is not null then bind it
         else
             Sampler::unbind(3); //if null unbind
-        shader->set("tex_material.roughness_map", 3);
+        program->set("tex_material.roughness_map", 3);
         //Specifies which texture unit to make active
         glActiveTexture(GL_TEXTURE0 + 4);
         if (emissive_map)
@@ -220,7 +221,7 @@ namespace our {
             emissive_sampler->bind(4); // check if sampler is not null then bind it
         else
             Sampler::unbind(4); //if null unbind
-        shader->set("tex_material.emissive_map", 4);
+        program->set("tex_material.emissive_map", 4);
         //Specifies which texture unit to make active
         glActiveTexture(GL_TEXTURE0 + 5);
         if (texture)
@@ -231,7 +232,7 @@ namespace our {
             sampler->bind(5); // check if sampler is not null then bind it
         else
             Sampler::unbind(5); //if null unbind
-        shader->set("tex", 5); // send the unit number to the uniform variable "tex"
+        program->set("tex", 5); // send the unit number to the uniform variable "tex"
 
     }
 
@@ -256,6 +257,17 @@ namespace our {
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
 
         alphaThreshold = data.value("alphaThreshold", 0.0f);
+
+        // The shader is specialized for the maps this material has, so the missing ones cost no texture fetches
+        // (see the material features in "assets/shaders/lit_texture.frag")
+        ShaderDefines features = {{"MATERIAL_FEATURES", "1"}};
+        if (albedo_map) features.emplace_back("HAS_ALBEDO_MAP", "1");
+        if (specular_map) features.emplace_back("HAS_SPECULAR_MAP", "1");
+        if (ambient_occlusion_map) features.emplace_back("HAS_AMBIENT_OCCLUSION_MAP", "1");
+        if (roughness_map) features.emplace_back("HAS_ROUGHNESS_MAP", "1");
+        if (emissive_map) features.emplace_back("HAS_EMISSIVE_MAP", "1");
+        if (texture) features.emplace_back("HAS_TEXTURE", "1");
+        if (shader) shader = shader->getVariant(features);
     }
 
 }
\ No newline at end of file
@@ -25,8 +25,14 @@ namespace our
         ShaderProgram *shader;
         bool transparent;
 
-        // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        // This function does 3 things: setup the pipeline state, set the shader program to be used
+        // and send the material uniforms (by calling "setupUniforms")
+        void setup() const;
+        // This function sends the material specific uniforms to the given program and binds its textures & samplers
+        // It assumes that the program is already in use. Materials that send uniforms to the shader should override it.
+        // The renderer calls it alone when the pipeline state and the shader are already set by a previous material.
+        // The program is usually "shader" but it can also be one of its variants (e.g. the instanced variant).
+        virtual void setupUniforms(ShaderProgram* /*program*/) const {}
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json &data);
     };
@@ -41,8 +47,8 @@ namespace our
 
         float shininess;
 
-        // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        // This function sends the lighting properties of the material to the shader
+        void setupUniforms(ShaderProgram* program) const override;
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
     };
@@ -54,7 +60,7 @@ namespace our
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        void setupUniforms(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json &data) override;
     };
 
@@ -65,7 +71,7 @@ namespace our
         glm::vec4 specular_tint;
         glm::vec4 emissive_tint;
 
-        void setup() const override;
+        void setupUniforms(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json& data) override;
     };
     // This material adds two uniforms (besides the tint from Tinted Material)
@@ -80,7 +86,7 @@ namespace our
         Sampler *sampler;
         float alphaThreshold;
 
-        void setup() const override;
+        void setupUniforms(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json &data) override;
     };
     class LitTexturedMaterial : public LitTintedMaterial
@@ -101,7 +107,7 @@ namespace our
 
         float alphaThreshold;
 
-        void setup() const override;
+        void setupUniforms(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -95,6 +95,24 @@ namespace our {
             glDepthMask(depthMask);
         }
 
+        // Two pipeline states are equal if applying one after the other would not change any OpenGL option
+        // This is used by the renderer to skip redundant pipeline setups
+        bool operator==(const PipelineState& other) const {
+            return faceCulling.enabled == other.faceCulling.enabled &&
+                   faceCulling.culledFace == other.faceCulling.culledFace &&
+                   faceCulling.frontFace == other.faceCulling.frontFace &&
+                   depthTesting.enabled == other.depthTesting.enabled &&
+                   depthTesting.function == other.depthTesting.function &&
+                   blending.enabled == other.blending.enabled &&
+                   blending.equation == other.blending.equation &&
+                   blending.sourceFactor == other.blending.sourceFactor &&
+                   blending.destinationFactor == other.blending.destinationFactor &&
+                   blending.constantColor == other.blending.constantColor &&
+                   colorMask == other.colorMask &&
+                   depthMask == other.depthMask;
+        }
+        bool operator!=(const PipelineState& other) const { return !(*this == other); }
+
         // Given a json object, this function deserializes a PipelineState structure
         void deserialize(const nlohmann::json& data);
     };
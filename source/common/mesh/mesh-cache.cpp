@@ -0,0 +1,179 @@
+#include "mesh-cache.hpp"
+#include "../mapped-file.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+namespace our::mesh_cache {
+
+    static_assert(sizeof(MeshCacheHeader) == 80, "The mesh cache header must have the same layout on all platforms");
+
+    namespace {
+
+        // The size, modification time & existence of the source file
+        struct SourceInfo {
+            bool exists = false;
+            uint64_t size = 0;
+            int64_t time = 0;
+        };
+
+        SourceInfo getSourceInfo(const std::string& path) {
+            SourceInfo info;
+            std::error_code error;
+            auto size = std::filesystem::file_size(path, error);
+            if(error) return info;
+            auto time = std::filesystem::last_write_time(path, error);
+            if(error) return info;
+            info.exists = true;
+            info.size = size;
+            info.time = (int64_t)time.time_since_epoch().count();
+            return info;
+        }
+
+        // Computes a 64-bit FNV-1a hash of the file content (returns 0 if the file could not be read)
+        uint64_t hashFile(const std::string& path) {
+            MappedFile file(path);
+            if(!file.isOpen()) return 0;
+            uint64_t hash = 14695981039346656037ull;
+            for(size_t i = 0; i < file.size(); i++){
+                hash ^= file.data()[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        // Checks that the header belongs to a valid cache file of the given size
+        bool isValidHeader(const MeshCacheHeader& header, size_t fileSize) {
+            if(std::memcmp(header.magic, "MESH", 4) != 0) return false;
+            if(header.version != MESH_CACHE_VERSION || header.vertexSize != sizeof(Vertex)) return false;
+            return fileSize == sizeof(MeshCacheHeader) + (size_t)header.vertexCount * sizeof(Vertex) + (size_t)header.indexCount * sizeof(unsigned int);
+        }
+
+        // The result of comparing a cache header with its source file
+        enum class Freshness {
+            UP_TO_DATE,   // The cache can be used as is
+            TIME_CHANGED, // The source was touched but its content did not change, so the cache can be used but its header should be refreshed
+            STALE         // The source changed, so the cache must be rebuilt
+        };
+
+        Freshness checkFreshness(const MeshCacheHeader& header, const SourceInfo& source, const std::string& sourcePath) {
+            // If the source is not shipped (e.g. only the baked meshes are distributed), we trust the cache
+            if(!source.exists) return Freshness::UP_TO_DATE;
+            if(source.size != header.sourceSize) return Freshness::STALE;
+            if(source.time == header.sourceTime) return Freshness::UP_TO_DATE;
+            // The time alone is not reliable (e.g. a checkout touches all the files), so we compare the content hash
+            return hashFile(sourcePath) == header.sourceHash ? Freshness::TIME_CHANGED : Freshness::STALE;
+        }
+
+        // Reads the header of a cache file (returns false if the file is not a valid cache)
+        bool readHeader(const std::string& cachePath, MeshCacheHeader& header) {
+            MappedFile file(cachePath);
+            if(!file.isOpen() || file.size() < sizeof(MeshCacheHeader)) return false;
+            std::memcpy(&header, file.data(), sizeof(MeshCacheHeader));
+            return isValidHeader(header, file.size());
+        }
+
+        // Overwrites the source time in the header of an existing cache file
+        void refreshTime(const std::string& cachePath, MeshCacheHeader header, int64_t time) {
+            header.sourceTime = time;
+            std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+            if(file) file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+        }
+
+    }
+
+    std::string getCachePath(const std::string& sourcePath) {
+        return sourcePath + ".mesh";
+    }
+
+    Mesh* load(const std::string& sourcePath) {
+        mesh_utils::MeshData data;
+        if(!map(sourcePath, data)) return nullptr;
+        return mesh_utils::uploadMesh(data);
+    }
+
+    bool map(const std::string& sourcePath, mesh_utils::MeshData& data) {
+        std::string cachePath = getCachePath(sourcePath);
+        MeshCacheHeader header;
+        if(!readHeader(cachePath, header)) return false;
+
+        SourceInfo source = getSourceInfo(sourcePath);
+        Freshness freshness = checkFreshness(header, source, sourcePath);
+        if(freshness == Freshness::STALE) return false;
+        // Remember the new time so that the next load does not need to hash the source again
+        // This is done before the file is mapped since some platforms don't allow writing to a mapped file
+        if(freshness == Freshness::TIME_CHANGED) refreshTime(cachePath, header, source.time);
+
+        auto file = std::make_unique<MappedFile>(cachePath);
+        if(!file->isOpen() || file->size() < sizeof(MeshCacheHeader)) return false;
+        std::memcpy(&header, file->data(), sizeof(MeshCacheHeader));
+        if(!isValidHeader(header, file->size())) return false;
+
+        // The vertices and the elements will be sent to the GPU directly from the mapped file
+        const uint8_t* content = file->data() + sizeof(MeshCacheHeader);
+        data.vertices = reinterpret_cast<const Vertex*>(content);
+        data.vertexCount = header.vertexCount;
+        data.elements = reinterpret_cast<const unsigned int*>(content + (size_t)header.vertexCount * sizeof(Vertex));
+        data.elementCount = header.indexCount;
+        data.bounds = header.bounds;
+        data.file = std::move(file);
+        return true;
+    }
+
+    bool write(const std::string& sourcePath, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements) {
+        SourceInfo source = getSourceInfo(sourcePath);
+        if(!source.exists) return false;
+
+        MeshCacheHeader header = {};
+        std::memcpy(header.magic, "MESH", 4);
+        header.version = MESH_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.vertexCount = (uint32_t)vertices.size();
+        header.indexCount = (uint32_t)elements.size();
+        header.sourceSize = source.size;
+        header.sourceTime = source.time;
+        header.sourceHash = hashFile(sourcePath);
+        header.bounds = Mesh::computeBounds(vertices.data(), vertices.size());
+
+        // We write to a temporary file then rename it so that a crash never leaves a half written cache behind
+        std::string cachePath = getCachePath(sourcePath);
+        std::string temporaryPath = cachePath + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!file) return false;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+            file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+            file.write(reinterpret_cast<const char*>(elements.data()), elements.size() * sizeof(unsigned int));
+            if(!file) return false;
+        }
+        std::error_code error;
+        std::filesystem::remove(cachePath, error);
+        std::filesystem::rename(temporaryPath, cachePath, error);
+        if(error){
+            std::cerr << "Failed to write the mesh cache \"" << cachePath << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    bool bake(const std::string& sourcePath, bool force) {
+        if(!force){
+            MeshCacheHeader header;
+            std::string cachePath = getCachePath(sourcePath);
+            if(readHeader(cachePath, header)){
+                SourceInfo source = getSourceInfo(sourcePath);
+                Freshness freshness = checkFreshness(header, source, sourcePath);
+                if(freshness == Freshness::TIME_CHANGED) refreshTime(cachePath, header, source.time);
+                if(freshness != Freshness::STALE) return true;
+            }
+        }
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> elements;
+        if(!mesh_utils::parseOBJ(sourcePath, vertices, elements)) return false;
+        return write(sourcePath, vertices, elements);
+    }
+
+}
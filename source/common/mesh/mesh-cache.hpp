@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "mesh-utils.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The mesh cache stores the result of parsing a model file (the deduplicated vertices, the elements and the bounds)
+// in a compact binary file next to it ("<model path>.mesh"). On later runs, the binary file is memory mapped and its content
+// is sent directly to the mesh buffers, so the model does not need to be parsed again.
+// The binary file layout is: MeshCacheHeader, then "vertexCount" vertices, then "indexCount" 32-bit indices.
+namespace our::mesh_cache {
+
+    // The header found at the start of every mesh cache file
+    struct MeshCacheHeader {
+        char magic[4];          // Always "MESH"
+        uint32_t version;       // The format version (MESH_CACHE_VERSION)
+        uint32_t vertexSize;    // sizeof(Vertex) when the file was written (a change in the vertex layout invalidates the cache)
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t reserved;
+        // The following identify the source file from which the cache was built
+        uint64_t sourceSize;    // The source file size in bytes
+        int64_t sourceTime;     // The source file last modification time
+        uint64_t sourceHash;    // A hash of the source file content (checked when the time changed but the content may not have)
+        MeshBounds bounds;      // The bounding box & sphere of the vertices
+    };
+
+    // Version 3: the triangles & the vertices are reordered by the mesh optimizer
+    constexpr uint32_t MESH_CACHE_VERSION = 3;
+
+    // Returns the path of the cache file of the given model file
+    std::string getCachePath(const std::string& sourcePath);
+
+    // Loads the mesh from the cache of the given model file
+    // If the cache does not exist or if it is stale, the function returns a nullptr
+    Mesh* load(const std::string& sourcePath);
+
+    // Maps the cache of the given model file and points "data" to its vertices and elements (without calling OpenGL)
+    // If the cache does not exist or if it is stale, the function returns false
+    bool map(const std::string& sourcePath, mesh_utils::MeshData& data);
+
+    // Writes the cache of the given model file using the given vertices and elements
+    // Returns false if the cache could not be written
+    bool write(const std::string& sourcePath, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements);
+
+    // Parses the given model file and writes its cache (without creating any OpenGL objects)
+    // If "force" is false and the cache is already up to date, nothing is done
+    // Returns false if the model could not be parsed or if the cache could not be written
+    bool bake(const std::string& sourcePath, bool force = false);
+
+}
@@ -0,0 +1,232 @@
+#include "mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace our::mesh_optimizer {
+
+    namespace {
+
+        // The size of the LRU cache modeled by the vertex cache pass and the constants of its scoring function
+        // (these are the values suggested by Tom Forsyth)
+        constexpr int MODELED_CACHE_SIZE = 32;
+        constexpr float CACHE_DECAY_POWER = 1.5f;
+        constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+        constexpr float VALENCE_BOOST_SCALE = 2.0f;
+        constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+        // The score of a vertex is higher if it was recently used (so the triangles using it hit the cache)
+        // or if few triangles still need it (so it can leave the cache for good sooner)
+        float scoreVertex(int cachePosition, unsigned int remainingTriangles) {
+            if(remainingTriangles == 0) return -1.0f; // The vertex is no longer needed
+            float score = 0.0f;
+            if(cachePosition >= 0){
+                // The vertices of the last triangle get a fixed score so that the next triangle doesn't always continue the same strip
+                if(cachePosition < 3) score = LAST_TRIANGLE_SCORE;
+                else score = std::pow(1.0f - (float)(cachePosition - 3) / (MODELED_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            return score + VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+        }
+
+    }
+
+    float computeACMR(const std::vector<unsigned int>& elements, size_t vertexCount, size_t cacheSize) {
+        size_t triangleCount = elements.size() / 3;
+        if(triangleCount == 0) return 0.0f;
+        // The time at which each vertex entered the cache. A vertex is still in the cache if less than "cacheSize" vertices entered after it.
+        std::vector<size_t> entryTime(vertexCount, 0);
+        size_t time = cacheSize + 1, misses = 0;
+        for(size_t i = 0; i < triangleCount * 3; i++){
+            unsigned int vertex = elements[i];
+            if(time - entryTime[vertex] > cacheSize){
+                entryTime[vertex] = time++;
+                misses++;
+            }
+        }
+        return (float)misses / triangleCount;
+    }
+
+    void optimizeVertexCache(std::vector<unsigned int>& elements, size_t vertexCount) {
+        size_t triangleCount = elements.size() / 3;
+        if(triangleCount == 0) return;
+
+        // The triangles using each vertex are stored in a single array (adjacencyOffsets[v] is where the triangles of "v" start)
+        std::vector<unsigned int> remaining(vertexCount, 0);
+        for(size_t i = 0; i < triangleCount * 3; i++) remaining[elements[i]]++;
+        std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+        for(size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+        std::vector<unsigned int> adjacency(triangleCount * 3);
+        {
+            std::vector<unsigned int> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for(size_t i = 0; i < triangleCount * 3; i++) adjacency[filled[elements[i]]++] = (unsigned int)(i / 3);
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++) vertexScore[v] = scoreVertex(-1, remaining[v]);
+        std::vector<float> triangleScore(triangleCount);
+        for(size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = vertexScore[elements[3 * t]] + vertexScore[elements[3 * t + 1]] + vertexScore[elements[3 * t + 2]];
+        std::vector<bool> emitted(triangleCount, false);
+
+        // The cache holds the most recently used vertices first. It can temporarily hold 3 extra vertices while it is updated.
+        std::vector<unsigned int> cache, nextCache;
+        cache.reserve(MODELED_CACHE_SIZE + 3);
+        nextCache.reserve(MODELED_CACHE_SIZE + 3);
+
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        size_t scanCursor = 0; // Used to find a new starting triangle when no triangle in the cache is left
+        long bestTriangle = -1;
+        while(result.size() < triangleCount * 3){
+            if(bestTriangle < 0){
+                // Every triangle in the cache was emitted, so we continue from the next triangle in the original order
+                while(emitted[scanCursor]) scanCursor++;
+                bestTriangle = (long)scanCursor;
+            }
+            emitted[bestTriangle] = true;
+            const unsigned int* triangle = &elements[3 * bestTriangle];
+            result.insert(result.end(), triangle, triangle + 3);
+
+            // Move the vertices of the triangle to the front of the cache
+            // (A degenerate triangle may use the same vertex twice but it is only cached once)
+            nextCache.clear();
+            for(int k = 0; k < 3; k++)
+                if(std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end()) nextCache.push_back(triangle[k]);
+            for(unsigned int vertex : cache)
+                if(vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) nextCache.push_back(vertex);
+            for(int k = 0; k < 3; k++){
+                unsigned int vertex = triangle[k];
+                remaining[vertex]--;
+                // Remove the emitted triangle from the list of the vertex's remaining triangles
+                unsigned int* begin = &adjacency[adjacencyOffsets[vertex]];
+                unsigned int* end = begin + remaining[vertex] + 1;
+                *std::find(begin, end, (unsigned int)bestTriangle) = end[-1];
+            }
+
+            // Update the scores of the vertices in the cache (and of the ones that just left it) then of their remaining triangles
+            for(size_t i = 0; i < nextCache.size(); i++){
+                unsigned int vertex = nextCache[i];
+                cachePosition[vertex] = i < (size_t)MODELED_CACHE_SIZE ? (int)i : -1;
+            }
+            bestTriangle = -1;
+            float bestScore = -1.0f;
+            for(unsigned int vertex : nextCache){
+                float score = scoreVertex(cachePosition[vertex], remaining[vertex]);
+                float delta = score - vertexScore[vertex];
+                vertexScore[vertex] = score;
+                for(unsigned int j = 0; j < remaining[vertex]; j++){
+                    unsigned int t = adjacency[adjacencyOffsets[vertex] + j];
+                    triangleScore[t] += delta;
+                }
+            }
+            // The best triangle is chosen among the triangles of the cached vertices
+            for(unsigned int vertex : nextCache){
+                for(unsigned int j = 0; j < remaining[vertex]; j++){
+                    unsigned int t = adjacency[adjacencyOffsets[vertex] + j];
+                    if(triangleScore[t] > bestScore){
+                        bestScore = triangleScore[t];
+                        bestTriangle = t;
+                    }
+                }
+            }
+            if(nextCache.size() > (size_t)MODELED_CACHE_SIZE) nextCache.resize(MODELED_CACHE_SIZE);
+            std::swap(cache, nextCache);
+        }
+        elements = std::move(result);
+    }
+
+    void optimizeOverdraw(std::vector<unsigned int>& elements, const std::vector<Vertex>& vertices) {
+        size_t triangleCount = elements.size() / 3;
+        if(triangleCount == 0) return;
+
+        // A new cluster starts at every triangle whose 3 vertices miss the cache: the cache restarts there anyway,
+        // so moving the cluster elsewhere barely changes the ACMR
+        std::vector<size_t> clusterStarts;
+        std::vector<size_t> entryTime(vertices.size(), 0);
+        size_t time = ACMR_CACHE_SIZE + 1;
+        for(size_t t = 0; t < triangleCount; t++){
+            int misses = 0;
+            for(int k = 0; k < 3; k++){
+                unsigned int vertex = elements[3 * t + k];
+                if(time - entryTime[vertex] > ACMR_CACHE_SIZE){
+                    entryTime[vertex] = time++;
+                    misses++;
+                }
+            }
+            if(misses == 3 || t == 0) clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+        size_t clusterCount = clusterStarts.size() - 1;
+        if(clusterCount < 2) return;
+
+        // The area weighted centroid of the whole mesh
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f)), clusterNormals(clusterCount, glm::vec3(0.0f));
+        for(size_t c = 0; c < clusterCount; c++){
+            float clusterArea = 0.0f;
+            for(size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++){
+                const glm::vec3& p0 = vertices[elements[3 * t]].position;
+                const glm::vec3& p1 = vertices[elements[3 * t + 1]].position;
+                const glm::vec3& p2 = vertices[elements[3 * t + 2]].position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // Its length is twice the triangle area
+                float area = glm::length(normal);
+                glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+                clusterCentroids[c] += centroid * area;
+                clusterNormals[c] += normal;
+                clusterArea += area;
+            }
+            meshCentroid += clusterCentroids[c];
+            meshArea += clusterArea;
+            if(clusterArea > 0) clusterCentroids[c] /= clusterArea;
+        }
+        if(meshArea > 0) meshCentroid /= meshArea;
+
+        // The more a cluster faces away from the mesh center, the earlier it is drawn
+        std::vector<float> sortKeys(clusterCount);
+        for(size_t c = 0; c < clusterCount; c++){
+            float length = glm::length(clusterNormals[c]);
+            glm::vec3 direction = length > 0 ? clusterNormals[c] / length : glm::vec3(0.0f);
+            sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, direction);
+        }
+        std::vector<size_t> order(clusterCount);
+        for(size_t c = 0; c < clusterCount; c++) order[c] = c;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<unsigned int> result;
+        result.reserve(elements.size());
+        for(size_t c : order)
+            result.insert(result.end(), elements.begin() + 3 * clusterStarts[c], elements.begin() + 3 * clusterStarts[c + 1]);
+        elements = std::move(result);
+    }
+
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& elements) {
+        constexpr unsigned int UNUSED = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), UNUSED);
+        std::vector<Vertex> result;
+        result.reserve(vertices.size());
+        for(unsigned int& element : elements){
+            if(remap[element] == UNUSED){
+                remap[element] = (unsigned int)result.size();
+                result.push_back(vertices[element]);
+            }
+            element = remap[element];
+        }
+        vertices = std::move(result);
+    }
+
+    OptimizationReport optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& elements, const OptimizationSettings& settings) {
+        auto start = std::chrono::steady_clock::now();
+        OptimizationReport report;
+        report.acmrBefore = computeACMR(elements, vertices.size());
+        if(settings.vertexCache) optimizeVertexCache(elements, vertices.size());
+        if(settings.overdraw) optimizeOverdraw(elements, vertices);
+        if(settings.vertexFetch) optimizeVertexFetch(vertices, elements);
+        report.acmrAfter = computeACMR(elements, vertices.size());
+        report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return report;
+    }
+
+}
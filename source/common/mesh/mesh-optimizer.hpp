@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vertex.hpp"
+#include <vector>
+#include <cstddef>
+
+// The mesh optimizer reorders the triangles & the vertices of an indexed mesh (without changing its shape) so that the GPU does less work:
+// - The vertex cache pass reorders the triangles so that the triangles sharing vertices are drawn close to each other,
+//   which lets the GPU reuse the transformed vertices from its post-transform cache instead of running the vertex shader again.
+// - The overdraw pass splits the result into clusters at the points where the cache restarts anyway, then sorts the clusters
+//   so that the ones facing away from the mesh center are drawn first (since they tend to occlude the others from most views).
+// - The vertex fetch pass reorders the vertices in the order they are first used so that the vertex fetches are more sequential.
+// The meshes are optimized once when they are parsed, then the result is stored in the mesh cache.
+namespace our::mesh_optimizer {
+
+    // The passes to run (all of them by default)
+    struct OptimizationSettings {
+        bool vertexCache = true;
+        bool overdraw = true;
+        bool vertexFetch = true;
+    };
+
+    // The average cache miss ratio (ACMR) is the number of transformed vertices per triangle.
+    // It ranges from 3 (no vertex is reused) down to about 0.5 for a regular grid (each vertex is transformed once).
+    struct OptimizationReport {
+        float acmrBefore = 0, acmrAfter = 0;
+        double milliseconds = 0; // The time taken by the optimization
+    };
+
+    // The size of the FIFO cache used to compute the ACMR (a typical size for the post-transform cache of the hardware)
+    constexpr size_t ACMR_CACHE_SIZE = 16;
+
+    // Computes the ACMR of the given triangle list by simulating a FIFO cache of the given size
+    float computeACMR(const std::vector<unsigned int>& elements, size_t vertexCount, size_t cacheSize = ACMR_CACHE_SIZE);
+
+    // Reorders the triangles for the post-transform vertex cache (using Tom Forsyth's "Linear-Speed Vertex Cache Optimisation")
+    void optimizeVertexCache(std::vector<unsigned int>& elements, size_t vertexCount);
+
+    // Sorts the clusters of triangles (found by simulating the vertex cache) from the most to the least outward facing
+    void optimizeOverdraw(std::vector<unsigned int>& elements, const std::vector<Vertex>& vertices);
+
+    // Reorders the vertices in the order they are first referenced by the elements (the unreferenced vertices are removed)
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& elements);
+
+    // Runs the enabled passes in order and returns the ACMR before & after them
+    OptimizationReport optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& elements, const OptimizationSettings& settings = {});
+
+}
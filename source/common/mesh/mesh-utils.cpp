@@ -1,23 +1,146 @@
 #include "mesh-utils.hpp"
+#include "mesh-cache.hpp"
+#include "mesh-optimizer.hpp"
 
 // We will use "Tiny OBJ Loader" to read and process '.obj" files
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tinyobj/tiny_obj_loader.h>
 
+#include <glm/gtc/packing.hpp>
+
 #include <iostream>
+#include <sstream>
 #include <vector>
-#include <unordered_map>
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+    // The vertex format in which the models are uploaded
+    our::VertexFormat vertexFormat = our::VertexFormat::FULL;
+
+    // Finds the index of each distinct vertex using an open addressing hash table (with linear probing).
+    // The table only stores the indices in "vertices" so it is much smaller and more cache friendly than an unordered_map<Vertex, GLuint>.
+    class VertexDeduplicator {
+        static constexpr GLuint EMPTY = ~0u;
+        std::vector<GLuint> table;
+        size_t mask;
+    public:
+        // The table is sized for the maximum number of vertices so that it is never more than half full
+        explicit VertexDeduplicator(size_t maxVertexCount) {
+            size_t size = 16;
+            while(size < maxVertexCount * 2) size *= 2;
+            table.assign(size, EMPTY);
+            mask = size - 1;
+        }
+
+        // Returns the index of the vertex in "vertices" (it is appended to "vertices" if it was not found)
+        GLuint find(const our::Vertex& vertex, std::vector<our::Vertex>& vertices) {
+            for(size_t slot = std::hash<our::Vertex>()(vertex) & mask;; slot = (slot + 1) & mask){
+                if(table[slot] == EMPTY){
+                    table[slot] = (GLuint)vertices.size();
+                    vertices.push_back(vertex);
+                    return table[slot];
+                }
+                if(vertices[table[slot]] == vertex) return table[slot];
+            }
+        }
+    };
+
+    // Packs the vertices into one of the compact layouts
+    template<typename CompactVertexType>
+    void packCompactVertices(const our::Vertex* vertices, size_t vertexCount, std::vector<uint8_t>& packed) {
+        packed.resize(vertexCount * sizeof(CompactVertexType));
+        for(size_t i = 0; i < vertexCount; i++){
+            const our::Vertex& vertex = vertices[i];
+            CompactVertexType compact;
+            compact.position = vertex.position;
+            if constexpr (std::is_same_v<CompactVertexType, our::CompactVertex>) compact.color = vertex.color;
+            compact.tex_coord = glm::packHalf2x16(vertex.tex_coord);
+            compact.normal = glm::packSnorm3x10_1x2(glm::vec4(glm::clamp(vertex.normal, -1.0f, 1.0f), 0.0f));
+            std::memcpy(packed.data() + i * sizeof(CompactVertexType), &compact, sizeof(CompactVertexType));
+        }
+    }
+}
+
+void our::mesh_utils::setVertexFormat(VertexFormat format) {
+    vertexFormat = format;
+}
+
+our::VertexFormat our::mesh_utils::getVertexFormat() {
+    return vertexFormat;
+}
+
+our::VertexFormat our::mesh_utils::parseVertexFormat(const std::string& name) {
+    if(name == "compact") return VertexFormat::COMPACT;
+    if(name == "compact-no-color") return VertexFormat::COMPACT_NO_COLOR;
+    if(name != "full") std::cerr << "Unknown vertex format \"" << name << "\", the full format will be used" << std::endl;
+    return VertexFormat::FULL;
+}
+
+void our::mesh_utils::packMesh(MeshData& data, VertexFormat format) {
+    // Most models have no vertex colors (so they are all white), in which case the color is not worth storing
+    if(format == VertexFormat::COMPACT){
+        bool white = true;
+        for(size_t i = 0; white && i < data.vertexCount; i++) white = data.vertices[i].color == Color(255);
+        if(white) format = VertexFormat::COMPACT_NO_COLOR;
+    }
+    data.format = format;
+    if(format == VertexFormat::COMPACT) packCompactVertices<CompactVertex>(data.vertices, data.vertexCount, data.packedVertices);
+    else if(format == VertexFormat::COMPACT_NO_COLOR) packCompactVertices<CompactVertexNoColor>(data.vertices, data.vertexCount, data.packedVertices);
+    else data.packedVertices.clear();
+
+    // The 16-bit elements halve the size of the element buffer
+    if(data.vertexCount <= 65536){
+        data.indexType = GL_UNSIGNED_SHORT;
+        data.shortElements.assign(data.elements, data.elements + data.elementCount);
+    } else {
+        data.indexType = GL_UNSIGNED_INT;
+        data.shortElements.clear();
+    }
+}
 
 our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
+    MeshData data;
+    if(!decodeOBJ(filename, data)) return nullptr;
+    return uploadMesh(data);
+}
+
+bool our::mesh_utils::decodeOBJ(const std::string& filename, MeshData& data) {
+
+    // If the file was already parsed in a previous run, the mesh is read directly from the binary cache
+    if(our::mesh_cache::map(filename, data)){
+        packMesh(data, vertexFormat);
+        return true;
+    }
 
     // The data that we will use to initialize our mesh
-    std::vector<our::Vertex> vertices;
-    std::vector<GLuint> elements;
+    if(!parseOBJ(filename, data.vertexStorage, data.elementStorage)) return false;
+
+    // Store the parsed data so that the next runs can skip parsing
+    our::mesh_cache::write(filename, data.vertexStorage, data.elementStorage);
+
+    data.vertices = data.vertexStorage.data();
+    data.vertexCount = data.vertexStorage.size();
+    data.elements = data.elementStorage.data();
+    data.elementCount = data.elementStorage.size();
+    data.bounds = Mesh::computeBounds(data.vertices, data.vertexCount);
+    packMesh(data, vertexFormat);
+    return true;
+}
+
+our::Mesh* our::mesh_utils::uploadMesh(const MeshData& data) {
+    // The packed arrays are used if "packMesh" filled them
+    const void* vertices = data.format == VertexFormat::FULL ? (const void*)data.vertices : data.packedVertices.data();
+    const void* elements = data.indexType == GL_UNSIGNED_SHORT ? (const void*)data.shortElements.data() : data.elements;
+    return new our::Mesh(data.format, vertices, data.vertexCount, data.indexType, elements, data.elementCount, data.bounds);
+}
+
+bool our::mesh_utils::parseOBJ(const std::string& filename, std::vector<our::Vertex>& vertices, std::vector<GLuint>& elements) {
 
-    // Since the OBJ can have duplicated vertices, we make them unique using this map
-    // The key is the vertex, the value is its index in the vector "vertices".
-    // That index will be used to populate the "elements" vector.
-    std::unordered_map<our::Vertex, GLuint> vertex_map;
+    vertices.clear();
+    elements.clear();
+    auto start = std::chrono::steady_clock::now();
 
     // The data loaded by Tiny OBJ Loader
     tinyobj::attrib_t attrib;
@@ -27,12 +150,19 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
 
     if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
         std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return nullptr;
+        return false;
     }
     if (!warn.empty()) {
         std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
     }
 
+    // Since the OBJ can have duplicated vertices, we make them unique using this table
+    // It gives the index of each vertex in the vector "vertices" which will be used to populate the "elements" vector.
+    size_t indexCount = 0;
+    for (const auto &shape : shapes) indexCount += shape.mesh.indices.size();
+    VertexDeduplicator deduplicator(indexCount);
+    elements.reserve(indexCount);
+
     // An obj file can have multiple shapes where each shape can have its own material
     // Ideally, we would load each shape into a separate mesh or store the start and end of it in the element buffer to be able to draw each shape separately
     // But we ignored this fact since we don't plan to use multiple materials in the examples
@@ -66,22 +196,21 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
                     255
             };
 
-            // See if we already stored a similar vertex
-            auto it = vertex_map.find(vertex);
-            if (it == vertex_map.end()) {
-                // if no, add it to the vertices and record its index
-                auto new_vertex_index = static_cast<GLuint>(vertices.size());
-                vertex_map[vertex] = new_vertex_index;
-                elements.push_back(new_vertex_index);
-                vertices.push_back(vertex);
-            } else {
-                // if yes, just add its index in the elements vector
-                elements.push_back(it->second);
-            }
+            // Reuse the index of a similar vertex if we already stored one, otherwise the vertex is added
+            elements.push_back(deduplicator.find(vertex, vertices));
         }
     }
-
-    return new our::Mesh(vertices, elements);
+    double parseMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Reorder the triangles & the vertices for the GPU (the result is stored in the mesh cache, so this is only done once)
+    auto report = our::mesh_optimizer::optimize(vertices, elements);
+    // The line is built first so that the reports of the models parsed in parallel are not interleaved
+    std::ostringstream line;
+    line << "Loaded \"" << filename << "\": " << vertices.size() << " vertices, " << elements.size() / 3 << " triangles, parsed in "
+         << parseMilliseconds << " ms, ACMR " << report.acmrBefore << " -> " << report.acmrAfter
+         << " (optimized in " << report.milliseconds << " ms)\n";
+    std::cout << line.str();
+    return true;
 }
 
 // Create a sphere (the vertex order in the triangles are CCW from the outside)
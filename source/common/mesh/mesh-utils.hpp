@@ -1,11 +1,54 @@
 #pragma once
 
 #include "mesh.hpp"
+#include "../mapped-file.hpp"
 #include <string>
+#include <vector>
+#include <memory>
 
 namespace our::mesh_utils {
+    // The data of a mesh waiting to be uploaded to the GPU
+    // The arrays point either into the storage vectors (if the model was parsed) or into the mapped cache file
+    struct MeshData {
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        const GLuint* elements = nullptr;
+        size_t elementCount = 0;
+        MeshBounds bounds = {glm::vec3(0.0f), glm::vec3(0.0f), 0.0f};
+        // The owners of the arrays
+        std::vector<Vertex> vertexStorage;
+        std::vector<GLuint> elementStorage;
+        std::unique_ptr<MappedFile> file;
+        // The layout & the element type in which the mesh will be uploaded (see "packMesh")
+        VertexFormat format = VertexFormat::FULL;
+        GLenum indexType = GL_UNSIGNED_INT;
+        std::vector<uint8_t> packedVertices; // The vertices in "format" (empty if the format is FULL)
+        std::vector<GLushort> shortElements; // The elements narrowed to 16 bits (empty if "indexType" is GL_UNSIGNED_INT)
+    };
+
+    // Sets & gets the vertex format in which the models are uploaded (FULL by default)
+    // It should be set before any model is loaded since the models are decoded on worker threads
+    void setVertexFormat(VertexFormat format);
+    VertexFormat getVertexFormat();
+    // Parses a vertex format name: "full", "compact" or "compact-no-color" (returns FULL for an unknown name)
+    VertexFormat parseVertexFormat(const std::string& name);
+
+    // Packs the decoded vertices into the given format and narrows the elements to 16 bits if there are less than 65536 vertices
+    // If the format is COMPACT but all the vertices are white, the color is dropped (COMPACT_NO_COLOR)
+    void packMesh(MeshData& data, VertexFormat format);
+
     // Load an ".obj" file into the mesh
+    // The parsed data is stored in a binary cache next to the file (see "mesh-cache.hpp") which is used by the later loads
     Mesh* loadOBJ(const std::string& filename);
+    // Parse an ".obj" file into deduplicated vertices and elements (this does not create any OpenGL objects)
+    // Returns false if the file could not be parsed
+    bool parseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements);
+    // Reads an ".obj" file from its binary cache (or parses it and writes the cache) into "data"
+    // then packs it in the current vertex format (see "setVertexFormat").
+    // It doesn't call OpenGL so it can be called from any thread. Returns false if the file could not be loaded.
+    bool decodeOBJ(const std::string& filename, MeshData& data);
+    // Creates a mesh from the decoded data (it must be called from the OpenGL thread)
+    Mesh* uploadMesh(const MeshData& data);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
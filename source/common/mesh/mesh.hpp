@@ -1,6 +1,8 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <vector>
+#include <cstddef>
 #include "vertex.hpp"
 
 namespace our
@@ -10,6 +12,19 @@ namespace our
 #define ATTRIB_LOC_COLOR 1
 #define ATTRIB_LOC_TEXCOORD 2
 #define ATTRIB_LOC_NORMAL 3
+// The per-instance attributes used by the instanced shaders (each mat4 takes 4 consecutive locations)
+#define ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD 4
+#define ATTRIB_LOC_INSTANCE_OBJECT_TO_INV_TRANSPOSE 8
+
+    // The bounding volumes of the mesh vertices in the local space:
+    // an axis aligned bounding box (min & max) and a bounding sphere centered at the center of the box
+    struct MeshBounds
+    {
+        glm::vec3 min, max;
+        float radius; // The distance from the box center to the farthest vertex
+
+        glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+    };
 
     class Mesh
     {
@@ -19,6 +34,31 @@ namespace our
         unsigned int VAO;
         // We need to remember the number of elements that will be draw by glDrawElements
         GLsizei elementCount;
+        // The size of the vertex & element buffers in bytes (used by the asset cache to track the memory usage)
+        size_t byteSize;
+        // The type of the elements (GL_UNSIGNED_SHORT if the mesh has less than 65536 vertices & was packed, otherwise GL_UNSIGNED_INT)
+        GLenum indexType;
+        // The layout of the vertices in the vertex buffer
+        VertexFormat format;
+        // The bounding volumes of the vertices (computed once when the mesh is built)
+        MeshBounds bounds;
+
+        // Points the position, texture coordinate & normal attributes to the given compact vertex layout
+        template <typename CompactVertexType>
+        static void setupCompactAttributes()
+        {
+            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(CompactVertexType), (void *)offsetof(CompactVertexType, position));
+
+            // Texture (size 2, type half float), the shader still receives a vec2
+            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertexType), (void *)offsetof(CompactVertexType, tex_coord));
+
+            // Normal (size must be 4 for the packed type, normalized true so each 10-bit component is mapped to [-1, 1])
+            // The shader only reads the first 3 components
+            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertexType), (void *)offsetof(CompactVertexType, normal));
+        }
 
     public:
         // The constructor takes two vectors:
@@ -29,6 +69,18 @@ namespace our
         // an element buffer to store the element data on the VRAM,
         // a vertex array object to define how to read the vertex & element buffer during rendering
         Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements)
+            : Mesh(vertices.data(), vertices.size(), elements.data(), elements.size()) {}
+
+        // This constructor reads the vertices and the elements from raw arrays (e.g. a memory mapped mesh cache file)
+        // If the bounds are already known, they can be given to avoid computing them from the vertices
+        Mesh(const Vertex *vertices, size_t vertexCount, const unsigned int *elements, size_t indexCount, const MeshBounds *knownBounds = nullptr)
+            : Mesh(VertexFormat::FULL, vertices, vertexCount, GL_UNSIGNED_INT, elements, indexCount,
+                   knownBounds ? *knownBounds : computeBounds(vertices, vertexCount)) {}
+
+        // This constructor reads vertices that are already packed in the given format (see "mesh_utils::packMesh")
+        // and elements of the given type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+        Mesh(VertexFormat format, const void *vertices, size_t vertexCount, GLenum indexType, const void *elements, size_t indexCount, const MeshBounds &bounds)
+            : indexType(indexType), format(format), bounds(bounds)
         {
             // DONE (Req 2) Write this function
             //  remember to store the number of elements in "elementCount" since you will need it for drawing
@@ -46,28 +98,45 @@ namespace our
 
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
             // Size of array is size of each Vertex * number of vertices
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+            size_t vertexSize = getVertexSize(format);
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, vertices, GL_STATIC_DRAW);
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
             // Size of array is size of each element * number of elements
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
-            elementCount = (int)elements.size();
-
-            // Position (size 3 Vec3 (XYZ), type float, normalized false, stride 3 floats or the size of thr vertex, offset 0)
-            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
-            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
-
-            // Color (size 4 Vec4 (RGBA), type Unsigned byte 0-255, normalized true(-1-1), Size of thr vertex, offset vertex with color)
-            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
-            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)offsetof(Vertex, color));
-
-            // Texture (size 2 Vec2, type float, normalized false, Size of the vertex, offset 0)
-            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
-            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, tex_coord));
-
-            // Normal (size 3 Vec3, type float, normalized false, stride Size of thr vertex, offset 0)
-            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
-            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+            size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, elements, GL_STATIC_DRAW);
+            elementCount = (GLsizei)indexCount;
+            byteSize = vertexCount * vertexSize + indexCount * indexSize;
+
+            switch (format)
+            {
+            case VertexFormat::FULL:
+                // Position (size 3 Vec3 (XYZ), type float, normalized false, stride 3 floats or the size of thr vertex, offset 0)
+                glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+                glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
+
+                // Color (size 4 Vec4 (RGBA), type Unsigned byte 0-255, normalized true(-1-1), Size of thr vertex, offset vertex with color)
+                glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+                glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)offsetof(Vertex, color));
+
+                // Texture (size 2 Vec2, type float, normalized false, Size of the vertex, offset 0)
+                glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+                glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, tex_coord));
+
+                // Normal (size 3 Vec3, type float, normalized false, stride Size of thr vertex, offset 0)
+                glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+                glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+                break;
+            case VertexFormat::COMPACT:
+                setupCompactAttributes<CompactVertex>();
+                glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+                glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, color));
+                break;
+            case VertexFormat::COMPACT_NO_COLOR:
+                // The color attribute is left disabled so the shaders read the current value set in "bind"
+                setupCompactAttributes<CompactVertexNoColor>();
+                break;
+            }
 
             glBindVertexArray(0);
         }
@@ -76,11 +145,63 @@ namespace our
         void draw()
         {
             // DONE (Req 2) Write this function
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0);
+            bind();
+            glDrawElements(GL_TRIANGLES, elementCount, indexType, 0);
             glBindVertexArray(0);
         }
 
+        // These two functions split "draw" so that a renderer drawing the same mesh multiple times in a row
+        // can bind its vertex array once then issue all the draw calls
+        void bind() const
+        {
+            glBindVertexArray(VAO);
+            // The value of a disabled attribute is part of the context state (not the vertex array), so it is set on every bind
+            if (format == VertexFormat::COMPACT_NO_COLOR)
+                glVertexAttrib4f(ATTRIB_LOC_COLOR, 1.0f, 1.0f, 1.0f, 1.0f);
+        }
+        // This function assumes that the mesh is already bound
+        void drawElements() const
+        {
+            glDrawElements(GL_TRIANGLES, elementCount, indexType, 0);
+        }
+        // This function draws multiple instances of the mesh in a single draw call
+        // It assumes that the mesh is already bound and that the instance attributes are set in its vertex array
+        void drawElementsInstanced(GLsizei instanceCount) const
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, elementCount, indexType, 0, instanceCount);
+        }
+
+        // Returns the size of the vertex & element buffers in bytes
+        size_t getByteSize() const { return byteSize; }
+        // Returns the layout of the vertices and the type of the elements
+        VertexFormat getVertexFormat() const { return format; }
+        GLenum getIndexType() const { return indexType; }
+        // Returns the bounding volumes of the mesh in its local space
+        const MeshBounds &getBounds() const { return bounds; }
+
+        // Computes the bounding volumes of the given vertices
+        static MeshBounds computeBounds(const Vertex *vertices, size_t vertexCount)
+        {
+            if (vertexCount == 0)
+                return {glm::vec3(0.0f), glm::vec3(0.0f), 0.0f};
+            MeshBounds result = {vertices[0].position, vertices[0].position, 0.0f};
+            for (size_t i = 1; i < vertexCount; i++)
+            {
+                result.min = glm::min(result.min, vertices[i].position);
+                result.max = glm::max(result.max, vertices[i].position);
+            }
+            // A second pass finds the farthest vertex from the box center (this is tighter than half the box diagonal)
+            glm::vec3 center = result.getCenter();
+            float radiusSquared = 0.0f;
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                glm::vec3 offset = vertices[i].position - center;
+                radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+            }
+            result.radius = glm::sqrt(radiusSquared);
+            return result;
+        }
+
         // this function should delete the vertex & element buffers and the vertex array object
         ~Mesh()
         {
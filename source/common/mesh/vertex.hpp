@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
+#include <cstdint>
+#include <cstring>
 
 namespace our {
 
@@ -24,21 +26,75 @@ namespace our {
         }
     };
 
+    // The layouts in which the vertices can be stored in the vertex buffer.
+    // The compact layouts trade some precision for less memory & vertex fetch bandwidth:
+    // the texture coordinates are stored as half floats and the normal as a signed normalized 10-10-10-2 integer.
+    enum class VertexFormat {
+        FULL,               // "Vertex" as is (36 bytes)
+        COMPACT,            // "CompactVertex" (24 bytes)
+        COMPACT_NO_COLOR    // "CompactVertexNoColor" (20 bytes). The shaders receive a white vertex color.
+    };
+
+    struct CompactVertex {
+        glm::vec3 position;
+        Color color;
+        glm::uint32 tex_coord;  // Two half floats (see glm::packHalf2x16)
+        glm::uint32 normal;     // Read as GL_INT_2_10_10_10_REV (see glm::packSnorm3x10_1x2)
+    };
+
+    struct CompactVertexNoColor {
+        glm::vec3 position;
+        glm::uint32 tex_coord;
+        glm::uint32 normal;
+    };
+
+    static_assert(sizeof(Vertex) == 36 && sizeof(CompactVertex) == 24 && sizeof(CompactVertexNoColor) == 20,
+        "The vertex layouts must be tightly packed");
+
+    // Returns the size of a vertex in the given format
+    inline size_t getVertexSize(VertexFormat format) {
+        switch(format){
+            case VertexFormat::COMPACT: return sizeof(CompactVertex);
+            case VertexFormat::COMPACT_NO_COLOR: return sizeof(CompactVertexNoColor);
+            default: return sizeof(Vertex);
+        }
+    }
+
 }
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
 namespace std {
-    //A Simple method to combine two hash values
-    inline size_t hash_combine(size_t h1, size_t h2){ return h1 ^ (h2 << 1); }
-
     //A Hash function for struct Vertex
+    //Combining the hashes of the members with shifts & xors collides a lot on axis aligned data (e.g. many 0s and 1s),
+    //so each 32-bit word of the vertex is mixed into the hash with multiplications & rotations (like MurmurHash) instead
     template<> struct hash<our::Vertex> {
+        static uint64_t mix(uint64_t hash, uint32_t word) {
+            uint64_t k = word * 0x87c37b91114253d5ull;
+            k = (k << 31) | (k >> 33);
+            hash ^= k * 0x4cf5ad432745937full;
+            return ((hash << 27) | (hash >> 37)) * 5 + 0x52dce729;
+        }
+        static uint64_t mix(uint64_t hash, float value) {
+            // -0 and +0 are equal so they must have the same hash (adding 0 turns -0 into +0)
+            value += 0.0f;
+            uint32_t word;
+            std::memcpy(&word, &value, sizeof(word));
+            return mix(hash, word);
+        }
+
         size_t operator()(our::Vertex const& vertex) const {
-            size_t combined = hash<glm::vec3>()(vertex.position);
-            combined = hash_combine(combined, hash<our::Color>()(vertex.color));
-            combined = hash_combine(combined, hash<glm::vec2>()(vertex.tex_coord));
-            combined = hash_combine(combined, hash<glm::vec3>()(vertex.normal));
-            return combined;
+            uint64_t hash = 0x9e3779b97f4a7c15ull;
+            for(int i = 0; i < 3; i++) hash = mix(hash, vertex.position[i]);
+            hash = mix(hash, (uint32_t)vertex.color.r | (uint32_t)vertex.color.g << 8 | (uint32_t)vertex.color.b << 16 | (uint32_t)vertex.color.a << 24);
+            for(int i = 0; i < 2; i++) hash = mix(hash, vertex.tex_coord[i]);
+            for(int i = 0; i < 3; i++) hash = mix(hash, vertex.normal[i]);
+            // The final avalanche makes every input bit affect the low bits (which select the bucket)
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ull;
+            hash ^= hash >> 33;
+            return (size_t)hash;
         }
     };
 }
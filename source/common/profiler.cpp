@@ -0,0 +1,367 @@
+#include "profiler.hpp"
+
+#if defined(ENABLE_PROFILER)
+
+#include <glad/gl.h>
+#include <imgui.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <cstdint>
+#include <cfloat>
+
+namespace our::profiler {
+
+    namespace {
+
+        using Clock = std::chrono::steady_clock;
+
+        // All the times are stored in nanoseconds since the profiler was initialized
+        Clock::time_point epoch;
+        int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+        }
+
+        // A closed (or still open) scope of the current frame
+        struct ScopeRecord {
+            const char* name;
+            uint32_t depth;
+            int64_t start, end;
+        };
+
+        // A GPU scope whose query result is not read yet
+        struct PendingQuery {
+            const char* name;
+            GLuint query;
+            int64_t cpuStart; // Used to place the GPU scope in the trace (the GPU time is only a duration)
+        };
+
+        // The queries issued during a frame. They are read GPU_LATENCY frames later so the results are almost always available.
+        constexpr size_t GPU_LATENCY = 4;
+        struct GpuFrame {
+            int64_t frame = -1;
+            std::vector<PendingQuery> queries;
+        };
+
+        // The rolling history of a scope's time per frame (in milliseconds)
+        struct ScopeHistory {
+            std::vector<float> samples;
+            size_t next = 0; // Where the next sample will be written once the history is full
+            float frameTotal = 0; // The sum of the scope's times in the current frame (a scope can run many times per frame)
+            int64_t frame = -1; // The last frame in which the scope ran
+        };
+
+        // A line in the overlay
+        struct OverlayLine {
+            std::string name;
+            uint32_t depth;
+        };
+
+        // An event in the Chrome trace ("tid" 0 is the CPU and 1 is the GPU)
+        struct TraceEvent {
+            const char* name;
+            int tid;
+            int64_t start, duration;
+        };
+
+        struct Capture {
+            bool active = false;
+            std::string path;
+            int64_t first = 0, last = 0; // The range of captured frames
+            std::vector<TraceEvent> events;
+        };
+
+        bool initialized = false;
+        std::thread::id mainThread;
+        bool inFrame = false;
+        int64_t frameIndex = 0;
+
+        std::vector<ScopeRecord> cpuRecords;
+        uint32_t cpuDepth = 0;
+
+        GpuFrame gpuFrames[GPU_LATENCY];
+        std::vector<GLuint> freeQueries;
+        bool gpuScopeActive = false;
+
+        size_t historySize = 240;
+        std::unordered_map<std::string, ScopeHistory> cpuHistory, gpuHistory;
+        std::vector<OverlayLine> cpuLines, gpuLines; // The scopes in the order they ran in the last recorded frame
+        bool overlayVisible = false;
+
+        Capture capture;
+
+        bool isRecording() {
+            return initialized && inFrame && std::this_thread::get_id() == mainThread;
+        }
+
+        void addSample(ScopeHistory& history, float milliseconds) {
+            if(history.samples.size() < historySize) {
+                history.samples.push_back(milliseconds);
+            } else {
+                history.samples[history.next] = milliseconds;
+                history.next = (history.next + 1) % historySize;
+            }
+        }
+
+        // Adds the scope's time to its frame total (and starts a new total if this is the first time it runs in this frame)
+        // Returns true if this is the first time the scope runs in this frame
+        bool accumulate(ScopeHistory& history, int64_t frame, float milliseconds) {
+            if(history.frame != frame) {
+                history.frame = frame;
+                history.frameTotal = milliseconds;
+                return true;
+            }
+            history.frameTotal += milliseconds;
+            return false;
+        }
+
+        // Reads the results of the queries issued GPU_LATENCY frames ago then recycles the queries
+        void resolveGpuFrame(GpuFrame& gpuFrame) {
+            if(gpuFrame.frame < 0) return;
+            // If any result is still not available, we drop the whole frame instead of waiting for the GPU
+            bool available = true;
+            for(auto& pending : gpuFrame.queries) {
+                GLint ready = GL_FALSE;
+                glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &ready);
+                if(!ready) { available = false; break; }
+            }
+            if(available) {
+                std::vector<std::pair<ScopeHistory*, const char*>> touched;
+                for(auto& pending : gpuFrame.queries) {
+                    GLuint64 elapsed = 0;
+                    glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsed);
+                    ScopeHistory& history = gpuHistory[pending.name];
+                    if(accumulate(history, gpuFrame.frame, (float)(elapsed * 1e-6)))
+                        touched.emplace_back(&history, pending.name);
+                    if(capture.active && gpuFrame.frame >= capture.first && gpuFrame.frame <= capture.last)
+                        capture.events.push_back({pending.name, 1, pending.cpuStart, (int64_t)elapsed});
+                }
+                gpuLines.clear();
+                for(auto& [history, name] : touched) {
+                    addSample(*history, history->frameTotal);
+                    gpuLines.push_back({name, 0});
+                }
+            }
+            for(auto& pending : gpuFrame.queries) freeQueries.push_back(pending.query);
+            gpuFrame.queries.clear();
+            gpuFrame.frame = -1;
+        }
+
+        void writeCapture() {
+            nlohmann::json events = nlohmann::json::array();
+            for(auto& event : capture.events) {
+                events.push_back({
+                    {"name", event.name},
+                    {"cat", event.tid == 0 ? "cpu" : "gpu"},
+                    {"ph", "X"},
+                    {"pid", 0},
+                    {"tid", event.tid},
+                    {"ts", event.start * 1e-3},
+                    {"dur", event.duration * 1e-3}
+                });
+            }
+            // Name the two timelines
+            events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 0}, {"tid", 0}, {"args", {{"name", "CPU (main thread)"}}}});
+            events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 0}, {"tid", 1}, {"args", {{"name", "GPU"}}}});
+
+            std::filesystem::path path(capture.path);
+            std::error_code error;
+            if(path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), error);
+            std::ofstream file(path);
+            if(file) {
+                file << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+                std::cout << "Profiler trace saved to: " << capture.path << std::endl;
+            } else {
+                std::cerr << "Failed to save the profiler trace to: " << capture.path << std::endl;
+            }
+            capture = Capture();
+        }
+
+        // Returns the given percentile of the sorted samples
+        float percentile(const std::vector<float>& sorted, float fraction) {
+            if(sorted.empty()) return 0;
+            size_t index = std::min(sorted.size() - 1, (size_t)(fraction * (sorted.size() - 1) + 0.5f));
+            return sorted[index];
+        }
+
+        void drawTable(const char* title, const std::vector<OverlayLine>& lines, const std::unordered_map<std::string, ScopeHistory>& histories) {
+            ImGui::Text("%s", title);
+            ImGui::Columns(6, title);
+            ImGui::SetColumnWidth(0, 220);
+            for(const char* header : {"Scope", "Last", "Avg", "P50", "P95", "P99"}) {
+                ImGui::Text("%s", header);
+                ImGui::NextColumn();
+            }
+            ImGui::Separator();
+            std::vector<float> sorted;
+            for(auto& line : lines) {
+                auto it = histories.find(line.name);
+                if(it == histories.end() || it->second.samples.empty()) continue;
+                const ScopeHistory& history = it->second;
+                sorted = history.samples;
+                std::sort(sorted.begin(), sorted.end());
+                float sum = 0;
+                for(float sample : sorted) sum += sample;
+                size_t lastIndex = history.samples.size() < historySize ? history.samples.size() - 1 : (history.next + historySize - 1) % historySize;
+
+                ImGui::Text("%*s%s", (int)line.depth * 2, "", line.name.c_str()); ImGui::NextColumn();
+                ImGui::Text("%.3f", history.samples[lastIndex]); ImGui::NextColumn();
+                ImGui::Text("%.3f", sum / sorted.size()); ImGui::NextColumn();
+                ImGui::Text("%.3f", percentile(sorted, 0.50f)); ImGui::NextColumn();
+                ImGui::Text("%.3f", percentile(sorted, 0.95f)); ImGui::NextColumn();
+                ImGui::Text("%.3f", percentile(sorted, 0.99f)); ImGui::NextColumn();
+            }
+            ImGui::Columns(1);
+        }
+
+    }
+
+    CpuScope::CpuScope(const char* name) {
+        if(!isRecording()) { index = SIZE_MAX; return; }
+        index = cpuRecords.size();
+        cpuRecords.push_back({name, cpuDepth++, now(), 0});
+    }
+
+    CpuScope::~CpuScope() {
+        if(index == SIZE_MAX || !isRecording()) return;
+        cpuRecords[index].end = now();
+        cpuDepth--;
+    }
+
+    GpuScope::GpuScope(const char* name) {
+        active = isRecording() && !gpuScopeActive;
+        if(!active) return;
+        GLuint query;
+        if(freeQueries.empty()) {
+            glGenQueries(1, &query);
+        } else {
+            query = freeQueries.back();
+            freeQueries.pop_back();
+        }
+        GpuFrame& gpuFrame = gpuFrames[frameIndex % GPU_LATENCY];
+        gpuFrame.frame = frameIndex;
+        gpuFrame.queries.push_back({name, query, now()});
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        gpuScopeActive = true;
+    }
+
+    GpuScope::~GpuScope() {
+        if(!active) return;
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuScopeActive = false;
+    }
+
+    void initialize(const nlohmann::json& config) {
+        epoch = Clock::now();
+        mainThread = std::this_thread::get_id();
+        initialized = true;
+        if(!config.is_object()) return;
+        overlayVisible = config.value("overlay", false);
+        historySize = std::max<size_t>(1, config.value("history", (size_t)240));
+        if(auto& trace = config["trace"]; trace.is_object()) {
+            startCapture(trace.value("file", "profiles/trace.json"), trace.value("frames", 60));
+            // The capture starts at the requested frame instead of the next one
+            capture.first = trace.value("start", 0);
+            capture.last = capture.first + trace.value("frames", 60) - 1;
+        }
+    }
+
+    void beginFrame() {
+        if(!initialized) return;
+        inFrame = true;
+        cpuRecords.clear();
+        cpuDepth = 0;
+        // The queries of this slot were issued GPU_LATENCY frames ago, so we read them before reusing the slot
+        resolveGpuFrame(gpuFrames[frameIndex % GPU_LATENCY]);
+        // The whole frame is the root scope
+        cpuRecords.push_back({"Frame", cpuDepth++, now(), 0});
+    }
+
+    void endFrame() {
+        if(!initialized || !inFrame) return;
+        // The frame scope and any scope that is still open (e.g. a scope that spans many frames) end here
+        int64_t frameEnd = now();
+        for(auto& record : cpuRecords)
+            if(record.end == 0) record.end = frameEnd;
+        inFrame = false;
+
+        std::vector<std::pair<ScopeHistory*, const ScopeRecord*>> touched;
+        for(auto& record : cpuRecords) {
+            ScopeHistory& history = cpuHistory[record.name];
+            if(accumulate(history, frameIndex, (float)((record.end - record.start) * 1e-6)))
+                touched.emplace_back(&history, &record);
+        }
+        cpuLines.clear();
+        for(auto& [history, record] : touched) {
+            addSample(*history, history->frameTotal);
+            cpuLines.push_back({record->name, record->depth});
+        }
+
+        if(capture.active) {
+            if(frameIndex >= capture.first && frameIndex <= capture.last)
+                for(auto& record : cpuRecords)
+                    capture.events.push_back({record.name, 0, record.start, record.end - record.start});
+            // We wait until the GPU results of the last captured frame are read
+            if(frameIndex >= capture.last + (int64_t)GPU_LATENCY) writeCapture();
+        }
+        ++frameIndex;
+    }
+
+    void drawOverlay() {
+        if(!initialized || !overlayVisible) return;
+        ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 10, 10), ImGuiCond_Always, ImVec2(1, 0));
+        ImGui::SetNextWindowSize(ImVec2(520, 0));
+        ImGui::SetNextWindowBgAlpha(0.75f);
+        ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing);
+        ImGui::Text("Times in ms over the last %zu frames (F3: hide, F4: capture a trace)", historySize);
+        if(capture.active) ImGui::Text("Capturing a trace to: %s", capture.path.c_str());
+
+        // Plot the frame times in chronological order
+        if(auto it = cpuHistory.find("Frame"); it != cpuHistory.end()) {
+            const auto& samples = it->second.samples;
+            int offset = samples.size() < historySize ? 0 : (int)it->second.next;
+            ImGui::PlotLines("##Frame", samples.data(), (int)samples.size(), offset, "Frame", 0.0f, FLT_MAX, ImVec2(500, 60));
+        }
+        drawTable("CPU", cpuLines, cpuHistory);
+        ImGui::Separator();
+        drawTable("GPU", gpuLines, gpuHistory);
+        ImGui::End();
+    }
+
+    void setOverlayVisible(bool visible) { overlayVisible = visible; }
+    bool isOverlayVisible() { return overlayVisible; }
+
+    void startCapture(const std::string& path, int frames) {
+        if(capture.active) return;
+        capture.active = true;
+        capture.path = path;
+        capture.first = frameIndex + (inFrame ? 1 : 0);
+        capture.last = capture.first + std::max(frames, 1) - 1;
+        capture.events.clear();
+    }
+
+    void shutdown() {
+        if(!initialized) return;
+        // Read the remaining queries (waiting for them is fine since we are exiting) so that the trace is complete
+        glFinish();
+        for(size_t i = 0; i < GPU_LATENCY; i++) resolveGpuFrame(gpuFrames[(frameIndex + i) % GPU_LATENCY]);
+        if(capture.active && !capture.events.empty()) writeCapture();
+        capture = Capture();
+        if(!freeQueries.empty()) glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+        freeQueries.clear();
+        cpuHistory.clear();
+        gpuHistory.clear();
+        cpuLines.clear();
+        gpuLines.clear();
+        initialized = false;
+    }
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <string>
+
+// The profiler measures the time spent in named scopes every frame:
+// - CPU scopes (PROFILE_SCOPE) measure the wall clock time between their construction and destruction. They can be nested.
+// - GPU scopes (PROFILE_GPU_SCOPE) wrap the OpenGL commands issued inside them with a GL_TIME_ELAPSED query.
+//   Since only one GL_TIME_ELAPSED query can be active at a time, a GPU scope opened inside another GPU scope is ignored.
+//   The query results are read a few frames later so that the CPU never waits for the GPU.
+// The last frames are shown in an ImGui overlay (toggled using F3) with the average and the percentiles of each scope,
+// and a range of frames can be exported as a Chrome trace (open it in "chrome://tracing" or "ui.perfetto.dev").
+// Only the scopes opened on the main thread (the one that called "initialize") are recorded.
+//
+// The profiler is compiled only if ENABLE_PROFILER is defined (see the ENABLE_PROFILER option in CMakeLists.txt).
+// Otherwise, the macros expand to nothing and the functions are empty, so it costs nothing.
+
+// Creates a local variable with a unique name (since the macros can be used more than once in the same scope)
+#define OUR_PROFILER_CONCAT_IMPL(a, b) a##b
+#define OUR_PROFILER_CONCAT(a, b) OUR_PROFILER_CONCAT_IMPL(a, b)
+
+#if defined(ENABLE_PROFILER)
+
+// Measures the CPU time from this line till the end of the enclosing scope. The name must be a string literal.
+#define PROFILE_SCOPE(name) our::profiler::CpuScope OUR_PROFILER_CONCAT(profilerCpuScope, __LINE__)(name)
+// Measures the GPU time of the OpenGL commands from this line till the end of the enclosing scope. The name must be a string literal.
+#define PROFILE_GPU_SCOPE(name) our::profiler::GpuScope OUR_PROFILER_CONCAT(profilerGpuScope, __LINE__)(name)
+
+namespace our::profiler {
+
+    // Opens a CPU scope on construction and closes it on destruction
+    class CpuScope {
+        size_t index; // The index of the scope's record in the current frame (or SIZE_MAX if it is not recorded)
+    public:
+        explicit CpuScope(const char* name);
+        ~CpuScope();
+        CpuScope(const CpuScope&) = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+    };
+
+    // Begins a GL_TIME_ELAPSED query on construction and ends it on destruction
+    class GpuScope {
+        bool active; // False if another GPU scope was already active (so this one is ignored)
+    public:
+        explicit GpuScope(const char* name);
+        ~GpuScope();
+        GpuScope(const GpuScope&) = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+    };
+
+    // Initializes the profiler using the "profiler" object of the app config (if any). It must be called after the OpenGL context is created.
+    // The config can contain:
+    // - "overlay": whether the overlay is visible at startup (default: false)
+    // - "history": the number of frames used to compute the statistics (default: 240)
+    // - "trace": {"file": path, "start": first frame, "frames": frame count} to export a trace of the given frames
+    void initialize(const nlohmann::json& config);
+    // Marks the start and the end of a frame. The scopes must be opened and closed between these two calls.
+    void beginFrame();
+    void endFrame();
+    // Draws the overlay using ImGui (if it is visible). It must be called between ImGui::NewFrame and ImGui::Render
+    void drawOverlay();
+    void setOverlayVisible(bool visible);
+    bool isOverlayVisible();
+    // Records the next "frames" frames and exports them as a Chrome trace to the given path
+    void startCapture(const std::string& path, int frames);
+    // Writes any pending trace and deletes the queries. It must be called before the OpenGL context is destroyed.
+    void shutdown();
+
+}
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+
+namespace our::profiler {
+
+    inline void initialize(const nlohmann::json&) {}
+    inline void beginFrame() {}
+    inline void endFrame() {}
+    inline void drawOverlay() {}
+    inline void setOverlayVisible(bool) {}
+    inline bool isOverlayVisible() { return false; }
+    inline void startCapture(const std::string&, int) {}
+    inline void shutdown() {}
+
+}
+
+#endif
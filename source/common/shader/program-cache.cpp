@@ -0,0 +1,138 @@
+#include "program-cache.hpp"
+#include "../mapped-file.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <cstring>
+
+namespace our::program_cache {
+
+    static_assert(sizeof(ProgramCacheHeader) == 24, "The program cache header must have the same layout on all platforms");
+
+    namespace {
+        bool enabled = false;
+        std::string directory = "cache/programs";
+        // The vendor, renderer & version strings of the driver (a binary is only valid for the driver that produced it)
+        std::string driver;
+        ProgramCacheStats stats;
+
+        // A 64-bit FNV-1a hash that can be fed incrementally
+        void hashBytes(uint64_t& hash, const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for(size_t i = 0; i < size; i++){
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        std::string getCachePath(uint64_t key) {
+            std::ostringstream path;
+            path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+            return path.str();
+        }
+
+        std::string getString(GLenum name) {
+            const GLubyte* value = glGetString(name);
+            return value ? reinterpret_cast<const char*>(value) : "";
+        }
+    }
+
+    void initialize(const nlohmann::json& config) {
+        if(config.is_object()) directory = config.value("directory", directory);
+        bool requested = config.is_object() ? config.value("enabled", true) : true;
+
+        // Some drivers expose the functions but support no binary format (e.g. older Mesa drivers)
+        GLint formatCount = 0;
+        if(glGetProgramBinary && glProgramBinary && glProgramParameteri) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        enabled = requested && formatCount > 0;
+        driver = getString(GL_VENDOR) + '\n' + getString(GL_RENDERER) + '\n' + getString(GL_VERSION);
+        if(requested && !enabled)
+            std::cout << "The program binary cache is disabled since the driver supports no program binary format" << std::endl;
+    }
+
+    bool isEnabled() {
+        return enabled;
+    }
+
+    uint64_t computeKey(const std::vector<std::pair<GLenum, std::string>>& stages) {
+        uint64_t hash = 14695981039346656037ull;
+        hashBytes(hash, driver.data(), driver.size() + 1);
+        for(auto& [type, source] : stages){
+            hashBytes(hash, &type, sizeof(type));
+            hashBytes(hash, source.data(), source.size() + 1);
+        }
+        return hash;
+    }
+
+    bool load(GLuint program, uint64_t key) {
+        MappedFile file(getCachePath(key));
+        if(!file.isOpen() || file.size() < sizeof(ProgramCacheHeader)) return false;
+        ProgramCacheHeader header;
+        std::memcpy(&header, file.data(), sizeof(ProgramCacheHeader));
+        if(std::memcmp(header.magic, "PBIN", 4) != 0 || header.version != PROGRAM_CACHE_VERSION || header.key != key) return false;
+        if(file.size() != sizeof(ProgramCacheHeader) + (size_t)header.binaryLength) return false;
+
+        glProgramBinary(program, header.binaryFormat, file.data() + sizeof(ProgramCacheHeader), (GLsizei)header.binaryLength);
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if(status != GL_TRUE){
+            // The driver may reject a binary for any reason (e.g. it was updated without changing its version string)
+            stats.rejected++;
+            return false;
+        }
+        return true;
+    }
+
+    void store(GLuint program, uint64_t key) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0) return;
+        std::vector<uint8_t> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        ProgramCacheHeader header = {};
+        std::memcpy(header.magic, "PBIN", 4);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.binaryFormat = format;
+        header.binaryLength = (uint32_t)length;
+        header.key = key;
+
+        // We write to a temporary file then rename it so that a crash never leaves a half written binary behind
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string path = getCachePath(key);
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!file) return;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(ProgramCacheHeader));
+            file.write(reinterpret_cast<const char*>(binary.data()), length);
+            if(!file) return;
+        }
+        std::filesystem::remove(path, error);
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error){
+            std::cerr << "Failed to write the program binary \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    void recordLink(bool fromCache, double milliseconds) {
+        if(fromCache){
+            stats.hits++;
+            stats.hitMilliseconds += milliseconds;
+        } else {
+            stats.misses++;
+            stats.missMilliseconds += milliseconds;
+        }
+    }
+
+    const ProgramCacheStats& getStats() {
+        return stats;
+    }
+
+}
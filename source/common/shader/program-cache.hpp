@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include <glad/gl.h>
+#include <json/json.hpp>
+
+// The program cache stores the binaries of the linked shader programs on disk (using glGetProgramBinary)
+// so that the later runs load them with glProgramBinary instead of compiling & linking the GLSL sources again.
+// Each binary is keyed by a hash of the stage types & sources and of the driver vendor, renderer & version,
+// so editing a shader or updating the driver simply results in a new entry. If the driver rejects a binary anyway,
+// the program is compiled from its sources (and the entry is overwritten).
+// The binary file layout is: ProgramCacheHeader, then "binaryLength" bytes of the binary.
+namespace our::program_cache {
+
+    // The header found at the start of every program cache file
+    struct ProgramCacheHeader {
+        char magic[4];          // Always "PBIN"
+        uint32_t version;       // The format version (PROGRAM_CACHE_VERSION)
+        uint32_t binaryFormat;  // The driver specific format returned by glGetProgramBinary
+        uint32_t binaryLength;  // The size of the binary in bytes
+        uint64_t key;           // The key of the program (see "computeKey")
+    };
+
+    constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+    // The number of programs loaded from the cache and compiled from their sources (and the time spent on each)
+    struct ProgramCacheStats {
+        unsigned int hits = 0;      // The programs loaded from the cache
+        unsigned int misses = 0;    // The programs compiled from their sources
+        unsigned int rejected = 0;  // The cached binaries rejected by the driver (these programs are also counted as misses)
+        double hitMilliseconds = 0, missMilliseconds = 0;
+    };
+
+    // Enables the cache if the driver supports at least one program binary format. It must be called once the OpenGL context exists.
+    // The config is optional and has the form: { "enabled": true, "directory": "cache/programs" }
+    void initialize(const nlohmann::json& config);
+    // Returns true if the programs should be looked up in (and stored to) the cache
+    bool isEnabled();
+
+    // Computes the key of a program from its stages (the type & the source of each stage) and the current driver
+    uint64_t computeKey(const std::vector<std::pair<GLenum, std::string>>& stages);
+
+    // Loads the cached binary of the given key into the program
+    // Returns false if there is no cached binary or if the driver rejected it (the program can then be compiled as usual)
+    bool load(GLuint program, uint64_t key);
+    // Stores the binary of the linked program under the given key
+    // The program should be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set to GL_TRUE
+    void store(GLuint program, uint64_t key);
+
+    // Records how a program was linked (this is called by "ShaderProgram::link")
+    void recordLink(bool fromCache, double milliseconds);
+    // Returns the statistics since the start of the application
+    const ProgramCacheStats& getStats();
+
+}
@@ -1,62 +1,213 @@
 #include "shader.hpp"
+#include "program-cache.hpp"
 
 #include <cassert>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const {
+namespace {
+
+    // Reads the whole file into "content" (returns false if the file could not be opened)
+    bool readFile(const std::filesystem::path &path, std::string &content) {
+        std::ifstream file(path);
+        if(!file) return false;
+        content = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // If the line is an `#include "path"` directive, the path is returned in "path"
+    bool parseInclude(const std::string &line, std::string &path) {
+        size_t position = line.find_first_not_of(" \t");
+        if(position == std::string::npos || line[position] != '#') return false;
+        position = line.find_first_not_of(" \t", position + 1);
+        if(position == std::string::npos || line.compare(position, 7, "include") != 0) return false;
+        size_t begin = line.find('"', position + 7), end = begin == std::string::npos ? begin : line.find('"', begin + 1);
+        if(end == std::string::npos) return false;
+        path = line.substr(begin + 1, end - begin - 1);
+        return true;
+    }
+
+    // Appends the given source to "output" while replacing its include directives by the content of the included files.
+    // "files" holds the files that were already included (a file's index is its source string number in the "#line" directives).
+    // The lines that follow an included file are renumbered so that the compiler errors still point to the right lines.
+    bool expandIncludes(const std::string &source, size_t fileIndex, std::vector<std::string> &files, std::string &output) {
+        std::filesystem::path directory = std::filesystem::path(files[fileIndex]).parent_path();
+        std::istringstream stream(source);
+        std::string line, includePath;
+        for(size_t lineNumber = 1; std::getline(stream, line); lineNumber++){
+            if(!parseInclude(line, includePath)){
+                output += line;
+                output += '\n';
+                continue;
+            }
+            std::string path = (directory / includePath).lexically_normal().generic_string();
+            // A file is included once, which also breaks include cycles
+            if(std::find(files.begin(), files.end(), path) == files.end()){
+                std::string content;
+                if(!readFile(path, content)){
+                    std::cerr << "ERROR: Couldn't open the file \"" << path << "\" included by: " << files[fileIndex] << std::endl;
+                    return false;
+                }
+                files.push_back(path);
+                output += "#line 1 " + std::to_string(files.size() - 1) + "\n";
+                if(!expandIncludes(content, files.size() - 1, files, output)) return false;
+            }
+            output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+        }
+        return true;
+    }
+
+    // Inserts the defines right after the "#version" line (which must come before anything else in GLSL)
+    void injectDefines(std::string &source, const our::ShaderDefines &defines) {
+        if(defines.empty()) return;
+        std::string block;
+        for(auto& [name, value] : defines) block += "#define " + name + " " + value + "\n";
+        size_t version = source.find("#version");
+        size_t position = version == std::string::npos ? std::string::npos : source.find('\n', version);
+        if(position == std::string::npos){
+            source.insert(0, block + "#line 1 0\n");
+            return;
+        }
+        // The lines after "#version" are renumbered since the defines were inserted before them
+        size_t versionLine = std::count(source.begin(), source.begin() + position, '\n') + 1;
+        source.insert(position + 1, block + "#line " + std::to_string(versionLine + 1) + " 0\n");
+    }
+
+}
+
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type) {
     // Here, we open the file and read a string from it containing the GLSL code of our shader
-    std::ifstream file(filename);
-    if(!file){
+    std::string sourceString;
+    if(!readFile(filename, sourceString)){
         std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
         return false;
     }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char* sourceCStr = sourceString.c_str();
-    file.close();
+    sourceFiles.push_back({type, filename, false, ""});
+    return addStage(sourceString, type, filename);
+}
 
-    //DONE Complete this function
-    //Note: The function "checkForShaderCompilationErrors" checks if there is
-    // an error in the given shader. You should use it to check if there is a
-    // compilation error and print it so that you can know what is wrong with
-    // the shader. The returned string will be empty if there is no errors.
+bool our::ShaderProgram::attachSource(const std::string &source, GLenum type, const std::string &name) {
+    sourceFiles.push_back({type, name, true, source});
+    return addStage(source, type, name);
+}
 
-    //Create a shader object
-    GLuint shader = glCreateShader(type);
-    //Attach the GLSL code to the shader
-    glShaderSource(shader, 1, &sourceCStr, nullptr);
-    //Compile the shader
-    glCompileShader(shader);
+bool our::ShaderProgram::addStage(const std::string &source, GLenum type, const std::string &filename) {
+    // The includes are expanded and the defines are injected
+    std::vector<std::string> files = { filename };
+    std::string preprocessed;
+    if(!expandIncludes(source, 0, files, preprocessed)) return false;
+    injectDefines(preprocessed, defines);
 
-    std::string error = checkForShaderCompilationErrors(shader);
-    // Check if there is a compilation error and print it so that you can know what is wrong with the shader
-    if (error != "") {
-        std::cerr << "ERROR: Shader compilation failed with the following error: " << error << std::endl;
-        return false;
+    // The stage is compiled when the program is linked since the whole program may be found in the program cache
+    stages.emplace_back(type, std::move(preprocessed));
+    stageFiles.push_back(std::move(files));
+    return true;
+}
+
+our::ShaderProgram* our::ShaderProgram::createVariant(const ShaderDefines &extraDefines) const {
+    auto variant = std::make_unique<ShaderProgram>();
+    variant->defines = defines;
+    variant->defines.insert(variant->defines.end(), extraDefines.begin(), extraDefines.end());
+    for(auto& file : sourceFiles){
+        bool attached = file.generated ? variant->attachSource(file.source, file.type, file.filename) : variant->attach(file.filename, file.type);
+        if(!attached) return nullptr;
+    }
+    if(!variant->link()) return nullptr;
+    return variant.release();
+}
+
+our::ShaderProgram* our::ShaderProgram::getVariant(const ShaderDefines &extraDefines) {
+    if(extraDefines.empty()) return this;
+    std::string key;
+    for(auto& [name, value] : extraDefines) key += name + "=" + value + ";";
+    auto it = variants.find(key);
+    if(it == variants.end()){
+        std::unique_ptr<ShaderProgram> variant(createVariant(extraDefines));
+        if(variant && instancedVariant){
+            // The variant is drawn with instancing like this program, so its instanced variant gets the same defines
+            ShaderProgram* instanced = instancedVariant->createVariant(extraDefines);
+            if(instanced) variant->setInstancedVariant(instanced);
+            else variant.reset();
+        }
+        if(!variant) std::cerr << "ERROR: Couldn't compile the shader variant \"" << key << "\", so the original program is used instead" << std::endl;
+        it = variants.emplace(key, std::move(variant)).first;
     }
+    return it->second ? it->second.get() : this;
+}
+
+bool our::ShaderProgram::link() {
+    auto start = std::chrono::steady_clock::now();
+
+    // If this program was linked by a previous run, its binary is loaded instead of compiling the sources
+    bool cacheEnabled = program_cache::isEnabled();
+    uint64_t key = cacheEnabled ? program_cache::computeKey(stages) : 0;
+    bool fromCache = cacheEnabled && program_cache::load(program, key);
+    bool linked = fromCache || compileAndLink();
+    if(linked && cacheEnabled && !fromCache) program_cache::store(program, key);
+    stages.clear();
+    stageFiles.clear();
+    if(!linked) return false;
+    program_cache::recordLink(fromCache, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
 
-    //Attach the shader to the program
-    glAttachShader(program, shader);
-    //Delete the shader (it won't actually be deleted until the program that it's attached to has been destroyed)
-    glDeleteShader(shader);
+    //Build the uniform location table once so that "set" never has to query the driver
+    reflectUniforms();
     //We return true if the compilation succeeded
     return true;
 }
 
+bool our::ShaderProgram::compileAndLink() {
+    //DONE Complete this function
+    //Note: The function "checkForShaderCompilationErrors" checks if there is
+    // an error in the given shader. You should use it to check if there is a
+    // compilation error and print it so that you can know what is wrong with
+    // the shader. The returned string will be empty if there is no errors.
+    for(size_t i = 0; i < stages.size(); i++){
+        auto& [type, source] = stages[i];
+        const char* sourceCStr = source.c_str();
+
+        //Create a shader object
+        GLuint shader = glCreateShader(type);
+        //Attach the GLSL code to the shader
+        glShaderSource(shader, 1, &sourceCStr, nullptr);
+        //Compile the shader
+        glCompileShader(shader);
+
+        std::string error = checkForShaderCompilationErrors(shader);
+        // Check if there is a compilation error and print it so that you can know what is wrong with the shader
+        if (error != "") {
+            std::cerr << "ERROR: Shader compilation of \"" << stageFiles[i][0] << "\" failed with the following error: " << error << std::endl;
+            // The errors in included files are reported with the source string numbers of the "#line" directives
+            for(size_t file = 1; file < stageFiles[i].size(); file++)
+                std::cerr << "  (source string " << file << " is \"" << stageFiles[i][file] << "\")" << std::endl;
+            glDeleteShader(shader);
+            return false;
+        }
 
+        //Attach the shader to the program
+        glAttachShader(program, shader);
+        //Delete the shader (it won't actually be deleted until the program that it's attached to has been destroyed)
+        glDeleteShader(shader);
+    }
 
-bool our::ShaderProgram::link() const {
     //DONE Complete this function
     //Note: The function "checkForLinkingErrors" checks if there is
     // an error in the given program. You should use it to check if there is a
     // linking error and print it so that you can know what is wrong with the
     // program. The returned string will be empty if there is no errors.
 
+    //Ask the driver to keep the binary of the program so that it can be stored in the program cache
+    if(program_cache::isEnabled()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     //Link the program
     glLinkProgram(program);
 
@@ -70,6 +221,34 @@ bool our::ShaderProgram::link() const {
     return true;
 }
 
+void our::ShaderProgram::reflectUniforms() {
+    uniformLocations.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(maxLength > 0 ? maxLength : 1);
+    for(GLint index = 0; index < count; index++){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(program, (GLuint)index, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), length);
+        GLint location = glGetUniformLocation(program, name.c_str());
+        //Uniforms inside uniform blocks have no location so they are skipped
+        if(location < 0) continue;
+        uniformLocations[name] = location;
+        //Arrays of basic types are reported once as "name[0]", so we also register "name" and every other element
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0){
+            std::string base = name.substr(0, name.size() - 3);
+            uniformLocations[base] = location;
+            for(GLint element = 1; element < size; element++){
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(program, elementName.c_str());
+            }
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <utility>
+#include <algorithm>
 #include<iostream>
 #include <glm/glm.hpp>
 
@@ -8,6 +10,8 @@
 #include "../ecs/component.hpp"
 #include "../components/collider.hpp"
 #include "../application.hpp"
+#include "../profiler.hpp"
+#include "spatial-hash.hpp"
 
 
 
@@ -16,145 +20,192 @@ using namespace std;
 namespace our
 {
 
+    // An enum that defines how the collider system finds the candidate pairs before running the sphere test
+    enum class BroadphaseMode {
+        SPATIAL_HASH, // Only the colliders sharing a grid cell are tested against each other
+        ALL_PAIRS     // Every collider is tested against every other collider (kept as a reference)
+    };
+
+    // A contact is an ordered pair of colliders whose spheres overlap.
+    // Both (a, b) and (b, a) are reported since the game rules below are not symmetric.
+    typedef std::pair<Collider*, Collider*> Contact;
+
     class ColliderSystem {
         Application* app;
+        BroadphaseMode mode = BroadphaseMode::SPATIAL_HASH;
+        bool validate = false; // If true, the contacts of both modes are compared every frame and mismatches are reported
+        SpatialHash grid;
+        // These are kept as members to avoid reallocating them every frame
+        vector<Collider*> Colliders;
+        vector<Contact> contacts;
+        vector<Contact> referenceContacts; // Only used when "validate" is true
+        // The interned names used by the game rules (comparing them is cheaper than comparing strings)
+        const NameId playerName = internName("player"), monsterName = internName("monster"), skullName = internName("skull"),
+                     swordName = internName("sword"), planeName = internName("plane"),
+                     loseWallName = internName("lose_wall"), winWallName = internName("win_wall");
+
+        // The narrowphase: if distance between each collider center is less than sum of their radius, then they are colliding
+        static bool overlaps(const Collider* collider1, const Collider* collider2) {
+            return glm::distance(collider1->center, collider2->center) <= collider1->Radius + collider2->Radius;
+        }
+
+        // Since the two modes could report the contacts in a different order, we sort them before comparing
+        static void sortContacts(vector<Contact>& list) {
+            std::sort(list.begin(), list.end());
+        }
+
     public:
         // When a state enters, it should call this function and give it the pointer to the application
+        // The broadphase can be configured from the scene config in the form:
+        //    "collision": { "broadphase": "spatial-hash" or "all-pairs", "cellSize": 2.0, "validate": false }
         void enter(Application* app){
             this->app = app;
+            const auto& config = app->getConfig();
+            if(config.contains("scene") && config["scene"].contains("collision")){
+                const auto& collision = config["scene"]["collision"];
+                mode = collision.value("broadphase", "spatial-hash") == "all-pairs" ? BroadphaseMode::ALL_PAIRS : BroadphaseMode::SPATIAL_HASH;
+                grid.setCellSize(collision.value("cellSize", grid.getCellSize()));
+                validate = collision.value("validate", false);
+            }
         }
 
-        // This should be called every frame to update all entities containing a MovementComponent. 
+        void setBroadphaseMode(BroadphaseMode mode) { this->mode = mode; }
+        BroadphaseMode getBroadphaseMode() const { return mode; }
+
+        // Finds all the contacts between the given colliders using the given broadphase mode and stores them in "out"
+        // The colliders "center" must be up to date and, for the spatial hash mode, they must be registered in the grid
+        void findContacts(BroadphaseMode broadphase, const vector<Collider*>& colliders, vector<Contact>& out) {
+            out.clear();
+            if(broadphase == BroadphaseMode::ALL_PAIRS){
+                for (auto collider1 : colliders)
+                    for (auto collider2 : colliders)
+                        if (collider1 != collider2 && overlaps(collider1, collider2))
+                            out.emplace_back(collider1, collider2);
+            } else {
+                for (auto collider1 : colliders){
+                    grid.query(collider1, [&](Collider* collider2){
+                        if (overlaps(collider1, collider2))
+                            out.emplace_back(collider1, collider2);
+                    });
+                }
+            }
+        }
+
+        // This should be called every frame to update all entities containing a MovementComponent.
         void update(World* world, float deltaTime) {
-            vector<Collider*> Colliders; // Initialize vector to save all colliders
+            PROFILE_SCOPE("ColliderSystem");
+            Colliders.clear();
+
+            for(auto [collider] : world->view<Collider>()){
+                Entity* entity = collider->getOwner();
+                // Compute the world space center once per frame then update the collider's cells in the grid
+                collider->center = glm::vec3(entity->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1));
+                grid.update(collider);
+                Colliders.push_back(collider);
+            }
+            // The player is found using the world's name index
+            Entity * player = world->findByName(playerName);
+            Collider * playerCollider = player ? player->getComponent<Collider>() : nullptr;
+
+            findContacts(mode, Colliders, contacts);
+
+            if(validate){
+                // Run the other mode and make sure that both report the same set of contacts
+                BroadphaseMode other = mode == BroadphaseMode::ALL_PAIRS ? BroadphaseMode::SPATIAL_HASH : BroadphaseMode::ALL_PAIRS;
+                findContacts(other, Colliders, referenceContacts);
+                vector<Contact> sorted = contacts;
+                sortContacts(sorted);
+                sortContacts(referenceContacts);
+                if(sorted != referenceContacts){
+                    std::cerr << "ColliderSystem: broadphase mismatch (" << sorted.size() << " contacts vs "
+                              << referenceContacts.size() << " in the reference mode)" << std::endl;
+                }
+            }
 
+            // Entities destroyed by a contact are only marked for removal here and deleted after all the contacts are processed
+            // so that the remaining contacts never point to a deleted collider
+            for (auto& [collider1, collider2] : contacts)
+            {
+                if (world->isMarkedForRemoval(collider1->getOwner()) || world->isMarkedForRemoval(collider2->getOwner())) continue;
 
-            Entity * player = nullptr;
-            for(auto entity : world->getEntities()){
-                auto collider = entity->getComponent<Collider>();
-                if(collider) // if collider exists , push it to vector
+                // Get name of each collider
+                NameId collider1_name = collider1->getOwner()->getNameId();
+                NameId collider2_name = collider2->getOwner()->getNameId();
+
+                // Destroy monster who got hit by sword
+                if(collider1_name==swordName && collider2_name==monsterName)
                 {
-                    Colliders.push_back(collider);
+                    world->markForRemoval(collider2->getOwner());
                 }
-                if(entity->name == "player")
+
+                // If player collides with monster or skull, player loses health
+                if(collider1_name==playerName && (collider2_name==monsterName || collider2_name == skullName))
                 {
-                    player = entity;
+                    if (health == 2)
+                    {
+                        health -= 1;
+                        world->markForRemoval(collider2->getOwner()); // delete the monster who hit the player
+                        app->changeState("injured"); // change state to injured
+                    }
+                    else if (health == 1)
+                    {
+                        app->changeState("lose"); // change state to lose
+                    }
                 }
             }
-            for (auto collider1 : Colliders)
-			{
-				for (auto collider2 : Colliders)
-				{
-					if (collider1 != collider2)
-					{
-                        // Get name of each collider
-						auto collider1_name = collider1->getOwner()->name; 
-						auto collider2_name = collider2->getOwner()->name;
-
-                        // Calculate center of each collider
-						auto collider1_center = collider1->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1);
-						auto collider2_center = collider2->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1);
-						
-                        // Calculate absolute distance between each collider center
-						auto dist = abs(glm::distance(collider1_center, collider2_center));
-                        
-            
-                        // If distance between each collider center is less than sum of their radius, then they are colliding
-						if (dist <= collider1->Radius + collider2->Radius) 
-						{
-                            // Destroy monster who got hit by sword
-                            if(collider1_name=="sword" && collider2_name=="monster") 
-                            {
-                                world->markForRemoval(collider2->getOwner());
-                                world->deleteMarkedEntities();
-                            }
-                            
-                            // If player collides with monster, player loses health
-                            if(collider1_name=="player" && collider2_name=="monster") 
-                            {
-                                if (health == 2)
-                                {
-                                    health -= 1;
-                                    world->markForRemoval(collider2->getOwner());
-                                    world->deleteMarkedEntities(); // delete the monster who hit the player
-                                    app->changeState("injured"); // change state to injured
-                                }
-                                else if (health == 1)
-                                {
-                                    app->changeState("lose"); // change state to lose
-                                }
-
-                            }
-
-                            // If player collides with skull, player loses health
-                            if (collider1_name == "player" && collider2_name == "skull")
-                            {
-                                if (health == 2)
-                                {
-                                    health -= 1;
-                                    world->markForRemoval(collider2->getOwner());
-                                    world->deleteMarkedEntities(); // delete the monster who hit the player
-                                    app->changeState("injured"); // change state to injured
-                                }
-                                else if (health == 1)
-                                {
-                                    app->changeState("lose"); // change state to lose
-                                }
-
-                            } 
-                            
-					    }
-                        // If player collides with plane, player goes up again
-                        if (collider1_name == "player" && collider2_name == "plane")
-                        {
-                            if (player->localTransform.position.y - 1.5 <= collider2->getOwner()->localTransform.position.y)
-                            {
-                                player->localTransform.position.y += 0.3f;
-                            }
-                            
-                        }
-                        // If player collides with lose plane, player loses
-                        if (collider1_name == "player" && collider2_name == "lose_wall")
-                        {
-                            // Must be close distance in the z-axis
-                            if (player->localTransform.position.z + 0.5 >= collider2->getOwner()->localTransform.position.z)
-                            {
-                                app->changeState("lose"); // change state to lose
-                            }
-                        }
 
-                        // If player collides with win plane , can't pass it z-axis
-                        if (collider1_name == "player" && collider2_name == "win_wall")
+            // The following rules compare the player position against some walls and planes regardless of
+            // whether their spheres are in contact, so they only need to visit the entities having these names
+            if (playerCollider)
+            {
+                for (auto plane : world->getEntitiesByName(planeName))
+                {
+                    if (plane == player || !plane->getComponent<Collider>()) continue;
+                    // If player collides with plane, player goes up again
+                    if (player->localTransform.position.y - 1.5 <= plane->localTransform.position.y)
+                    {
+                        player->localTransform.position.y += 0.3f;
+                    }
+                    // If player left the plane in the x-axis, player loses
+                    // Must be close distance in the x-axis
+                    if ( abs(player->localTransform.position.x) >= plane->localTransform.position.x + 9.5)
+                    {
+                        // Loses health
+                        if (health == 2)
                         {
-                            // Must be close distance in the z-axis
-                            if (player->localTransform.position.z - 0.3 <= collider2->getOwner()->localTransform.position.z)
-                            {
-                                player->localTransform.position.z += 0.6f;
-                            }
+                            health -= 1;
+                            app->changeState("injured"); // change state to injured
                         }
-
-                        // If player left the plane in the x-axis, player loses
-                        if (collider1_name == "player" && collider2_name == "plane")
+                        else if (health == 1)
                         {
-                            // Must be close distance in the x-axis
-                            if ( abs(player->localTransform.position.x) >= collider2->getOwner()->localTransform.position.x + 9.5)
-                            {
-                                // Loses health
-                                if (health == 2)
-                                {
-                                    health -= 1;
-                                    app->changeState("injured"); // change state to injured
-                                }
-                                else if (health == 1)
-                                {
-                                    app->changeState("injured"); // change state to injured
-                                }
-                            }
+                            app->changeState("injured"); // change state to injured
                         }
-
-				    }
-			    }
+                    }
+                }
+                // If player collides with lose plane, player loses
+                for (auto loseWall : world->getEntitiesByName(loseWallName))
+                {
+                    if (loseWall == player || !loseWall->getComponent<Collider>()) continue;
+                    // Must be close distance in the z-axis
+                    if (player->localTransform.position.z + 0.5 >= loseWall->localTransform.position.z)
+                    {
+                        app->changeState("lose"); // change state to lose
+                    }
+                }
+                // If player collides with win plane , can't pass it z-axis
+                for (auto winWall : world->getEntitiesByName(winWallName))
+                {
+                    if (winWall == player || !winWall->getComponent<Collider>()) continue;
+                    // Must be close distance in the z-axis
+                    if (player->localTransform.position.z - 0.3 <= winWall->localTransform.position.z)
+                    {
+                        player->localTransform.position.z += 0.6f;
+                    }
+                }
             }
+
+            // Finally, delete the entities that were destroyed by the contacts
+            world->deleteMarkedEntities();
         };
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,192 @@
+#include "dynamic-resolution.hpp"
+#include "../texture/texture-utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace our
+{
+
+    namespace
+    {
+        // The number of frames measured between two adjustments of the scale
+        constexpr unsigned int ADJUST_INTERVAL = 15;
+        // The scale is lowered when the GPU time goes over the target, and raised only when it falls below this fraction of the target.
+        // The gap prevents the scale from oscillating around the target.
+        constexpr double RAISE_THRESHOLD = 0.8;
+        // The scale change is aimed at this fraction of the target to leave some headroom
+        constexpr double AIM_FRACTION = 0.9;
+        // The largest change of the scale in a single adjustment
+        constexpr float MAX_SCALE_CHANGE = 0.1f;
+    }
+
+    RenderTarget::RenderTarget(glm::ivec2 size, bool withDepth) : size(size)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        color = texture_utils::empty(GL_RGBA, size);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color->getOpenGLName(), 0);
+        if (withDepth)
+        {
+            depth = texture_utils::empty(GL_DEPTH_COMPONENT, size);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth->getOpenGLName(), 0);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    RenderTarget::~RenderTarget()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        delete color;
+        delete depth;
+    }
+
+    RenderTarget *RenderTargetPool::acquire(glm::ivec2 size, bool withDepth)
+    {
+        for (Entry &entry : entries)
+        {
+            if (!entry.inUse && entry.target->size == size && (entry.target->depth != nullptr) == withDepth)
+            {
+                entry.inUse = true;
+                entry.lastUsedFrame = frame;
+                return entry.target.get();
+            }
+        }
+        entries.push_back({std::make_unique<RenderTarget>(size, withDepth), true, frame});
+        return entries.back().target.get();
+    }
+
+    void RenderTargetPool::release(RenderTarget *target)
+    {
+        for (Entry &entry : entries)
+        {
+            if (entry.target.get() == target)
+            {
+                entry.inUse = false;
+                entry.lastUsedFrame = frame;
+            }
+        }
+    }
+
+    void RenderTargetPool::endFrame()
+    {
+        frame++;
+        for (Entry &entry : entries)
+            if (entry.inUse)
+                entry.lastUsedFrame = frame;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry &entry)
+                                     { return !entry.inUse && frame - entry.lastUsedFrame > keepFrames; }),
+                      entries.end());
+    }
+
+    void RenderTargetPool::clear()
+    {
+        entries.clear();
+    }
+
+    void ResolutionController::initialize(const nlohmann::json &config)
+    {
+        settings = ResolutionSettings();
+        if (config.is_number())
+        {
+            settings.scale = config.get<float>();
+        }
+        else if (config.is_object())
+        {
+            settings.automatic = config.value("auto", false);
+            settings.scale = config.value("scale", settings.scale);
+            settings.minScale = config.value("min", settings.minScale);
+            settings.maxScale = config.value("max", settings.maxScale);
+            settings.targetMilliseconds = config.value("targetMilliseconds", settings.targetMilliseconds);
+            settings.step = config.value("step", settings.step);
+        }
+        settings.step = std::max(settings.step, 0.01f);
+        settings.minScale = std::clamp(settings.minScale, settings.step, 1.0f);
+        settings.maxScale = std::clamp(settings.maxScale, settings.minScale, 1.0f);
+        settings.scale = std::clamp(settings.scale, settings.automatic ? settings.minScale : settings.step, settings.automatic ? settings.maxScale : 1.0f);
+        scale = settings.scale;
+
+        gpuMilliseconds = -1.0;
+        framesSinceChange = 0;
+        nextQuery = 0;
+        measuring = false;
+        std::fill(std::begin(pending), std::end(pending), false);
+        if (settings.automatic)
+            glGenQueries(2 * QUERY_RING_SIZE, &queries[0][0]);
+    }
+
+    void ResolutionController::destroy()
+    {
+        if (queries[0][0])
+            glDeleteQueries(2 * QUERY_RING_SIZE, &queries[0][0]);
+        std::fill(&queries[0][0], &queries[0][0] + 2 * QUERY_RING_SIZE, 0);
+    }
+
+    void ResolutionController::update()
+    {
+        if (!settings.automatic)
+            return;
+        // The queries are read from the oldest and we stop at the first one that is not available yet
+        for (int i = 0; i < QUERY_RING_SIZE; i++)
+        {
+            int slot = (nextQuery + i) % QUERY_RING_SIZE;
+            if (!pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+            pending[slot] = false;
+            // The frames rendered before the last change of the scale do not tell anything about the current scale
+            if (queryScales[slot] != scale)
+                continue;
+            double milliseconds = (end - begin) / 1e6;
+            gpuMilliseconds = gpuMilliseconds < 0 ? milliseconds : gpuMilliseconds * 0.9 + milliseconds * 0.1;
+            framesSinceChange++;
+        }
+
+        if (gpuMilliseconds < 0 || framesSinceChange < ADJUST_INTERVAL)
+            return;
+        double target = settings.targetMilliseconds;
+        if (gpuMilliseconds <= target && gpuMilliseconds >= target * RAISE_THRESHOLD)
+            return;
+        // The fill cost is proportional to the pixel count which is the square of the scale
+        float desired = scale * (float)std::sqrt(target * AIM_FRACTION / gpuMilliseconds);
+        desired = std::clamp(desired, scale - MAX_SCALE_CHANGE, scale + MAX_SCALE_CHANGE);
+        desired = std::round(desired / settings.step) * settings.step;
+        desired = std::clamp(desired, settings.minScale, settings.maxScale);
+        if (desired != scale)
+        {
+            scale = desired;
+            gpuMilliseconds = -1.0;
+            framesSinceChange = 0;
+        }
+    }
+
+    void ResolutionController::beginFrame()
+    {
+        measuring = false;
+        if (!settings.automatic)
+            return;
+        // If the GPU is so far behind that all the queries are still pending, this frame is not measured
+        if (pending[nextQuery])
+            return;
+        glQueryCounter(queries[nextQuery][0], GL_TIMESTAMP);
+        measuring = true;
+    }
+
+    void ResolutionController::endFrame()
+    {
+        if (!measuring)
+            return;
+        glQueryCounter(queries[nextQuery][1], GL_TIMESTAMP);
+        queryScales[nextQuery] = scale;
+        pending[nextQuery] = true;
+        nextQuery = (nextQuery + 1) % QUERY_RING_SIZE;
+        measuring = false;
+    }
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../texture/texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+#include <memory>
+
+namespace our
+{
+
+    // An offscreen framebuffer with a color & a depth texture of the same size
+    // (The targets of the postprocess passes have no depth texture since they only draw a fullscreen triangle)
+    struct RenderTarget {
+        glm::ivec2 size;
+        Texture2D *color = nullptr, *depth = nullptr;
+        GLuint framebuffer = 0;
+
+        explicit RenderTarget(glm::ivec2 size, bool withDepth = true);
+        ~RenderTarget();
+        RenderTarget(const RenderTarget&) = delete;
+        RenderTarget& operator=(const RenderTarget&) = delete;
+    };
+
+    // Keeps the render targets that were released so that a target of the same size can be reused instead of allocated again.
+    // When the resolution scale changes back and forth, the renderer switches between existing targets. A released target is only
+    // deleted after it has not been used for a while, so the GPU finished using it long ago and deleting it does not wait for it.
+    class RenderTargetPool {
+        struct Entry {
+            std::unique_ptr<RenderTarget> target;
+            bool inUse;
+            unsigned int lastUsedFrame;
+        };
+        std::vector<Entry> entries;
+        unsigned int frame = 0;
+        // The number of frames after which an unused target is deleted
+        unsigned int keepFrames = 240;
+    public:
+        // Returns a target of the given size with or without depth (a released one if there is one, otherwise a new one)
+        RenderTarget* acquire(glm::ivec2 size, bool withDepth = true);
+        // Returns the target to the pool (it stays allocated till it expires)
+        void release(RenderTarget* target);
+        // Deletes the released targets that expired. It should be called once per frame.
+        void endFrame();
+        // Deletes all the targets
+        void clear();
+        // Returns the number of allocated targets
+        size_t size() const { return entries.size(); }
+    };
+
+    // The settings of the resolution scale. It is read from the renderer config using "resolutionScale" which is either
+    // a fixed scale (e.g. 0.75) or an object: { "auto": true, "min": 0.5, "max": 1.0, "targetMilliseconds": 14.0, "step": 0.05 }
+    struct ResolutionSettings {
+        // If true, the scale is adjusted by the controller to keep the GPU time of the frame within the target
+        bool automatic = false;
+        // The fixed scale (or the initial scale if automatic)
+        float scale = 1.0f;
+        // The range of the automatic scale
+        float minScale = 0.5f, maxScale = 1.0f;
+        // The GPU time budget of the frame rendered by the renderer
+        float targetMilliseconds = 14.0f;
+        // The scale is a multiple of this step so that only a few target sizes are ever allocated
+        float step = 0.05f;
+
+        // Returns true if the scene may be rendered at less than the window resolution
+        bool isEnabled() const { return automatic || scale != 1.0f; }
+    };
+
+    // Measures the GPU time of every frame using timestamp queries and adjusts the resolution scale to fit the budget.
+    // Timestamps are used (instead of a GL_TIME_ELAPSED query) so that they can be mixed with the profiler's GPU scopes.
+    // The queries are read a few frames later when their results are available, so the CPU never waits for the GPU.
+    class ResolutionController {
+        ResolutionSettings settings;
+        float scale = 1.0f;
+
+        // A ring of (begin, end) timestamp queries and the scale of the frame measured by each pair
+        static constexpr int QUERY_RING_SIZE = 4;
+        GLuint queries[QUERY_RING_SIZE][2] = {};
+        float queryScales[QUERY_RING_SIZE] = {};
+        bool pending[QUERY_RING_SIZE] = {};
+        int nextQuery = 0;
+        bool measuring = false; // True if the current frame is measured (false if all the queries are still pending)
+
+        // The smoothed GPU time of the frames (negative until the first measurement) and the frames since the last change
+        double gpuMilliseconds = -1.0;
+        unsigned int framesSinceChange = 0;
+
+    public:
+        // Reads the settings (see "ResolutionSettings") and creates the queries
+        void initialize(const nlohmann::json& config);
+        // Deletes the queries
+        void destroy();
+
+        // Reads the results of the finished queries and adjusts the scale.
+        // It should be called once per frame before the size of the scene target is chosen.
+        void update();
+        // Marks the start and the end of the measured GPU work of a frame: "beginFrame" should be called right before the scene
+        // target is bound & cleared and "endFrame" right after the last pass (that upscales the scene to the window) is drawn,
+        // so that the measurement only covers the work that scales with the resolution.
+        void beginFrame();
+        void endFrame();
+
+        const ResolutionSettings& getSettings() const { return settings; }
+        // Returns the scale of the render resolution relative to the window resolution
+        float getScale() const { return scale; }
+        // Returns the smoothed GPU time of the last measured frames (negative if none were measured yet)
+        double getGpuMilliseconds() const { return gpuMilliseconds; }
+    };
+
+}
@@ -1,6 +1,7 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../profiler.hpp"
 
 namespace our
 {
@@ -9,6 +10,27 @@ namespace our
     {
         // First, we store the window size for later use
         this->windowSize = windowSize;
+        // The shaders of a previous scene could have been deleted so we forget their uniform handles and sort key ids
+        shaderUniforms.clear();
+        pipelineStates.clear();
+        shaderIds.clear();
+        materialIds.clear();
+        meshIds.clear();
+        materialKeys.clear();
+
+        // Instancing is enabled by default
+        instancing = config.value("instancing", true);
+        // Frustum culling is enabled by default
+        frustumCulling = config.value("frustumCulling", true);
+        // The light variants are enabled by default
+        lightVariants = config.value("lightVariants", true);
+        lightMix = glm::ivec3(-1);
+        lightVariantShaders.clear();
+        // Create the instance buffer (its content is uploaded every frame in "buildOpaqueGroups")
+        glGenBuffers(1, &instanceBuffer);
+
+        // Create the buffers that hold the lights (their content is uploaded every frame in "render")
+        lightClusters.initialize(config.value("lightClusters", nlohmann::json::object()));
 
         // Then we check if there is a sky texture in the configuration
         if (config.contains("sky"))
@@ -54,55 +76,39 @@ namespace our
             this->skyMaterial->transparent = false;
         }
 
-        // Then we check if there is a postprocessing shader in the configuration
-        if (config.contains("postprocess"))
-        {
-            // TODO: (Req 11) Create a framebuffer
-            glGenFramebuffers(1, &postprocessFrameBuffer);
-
-            // TODO: (Req 11) Create a color and a depth texture and attach them to the framebuffer
-            //  Hints: The color format can be (Red, Green, Blue and Alpha components with 8 bits for each channel).
-            //  The depth format can be (Depth component with 24 bits).
-            glBindFramebuffer(GL_FRAMEBUFFER, postprocessFrameBuffer);
-
-            colorTarget = texture_utils::empty(GL_RGBA, windowSize);
-            depthTarget = texture_utils::empty(GL_DEPTH_COMPONENT, windowSize);
-
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTarget->getOpenGLName(), 0);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTarget->getOpenGLName(), 0);
-
-            // TODO: (Req 11) Unbind the framebuffer just to be safe
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-            // Create a vertex array to use for drawing the texture
-            glGenVertexArrays(1, &postProcessVertexArray);
-
-            // Create a sampler to use for sampling the scene texture in the post processing shader
-            Sampler *postprocessSampler = new Sampler();
-            postprocessSampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            postprocessSampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            postprocessSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            // Create the post processing shader
-            ShaderProgram *postprocessShader = new ShaderProgram();
-            postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-            postprocessShader->attach(config.value<std::string>("postprocess", ""), GL_FRAGMENT_SHADER);
-            postprocessShader->link();
-
-            // Create a post processing material
-            postprocessMaterial = new TexturedMaterial();
-            postprocessMaterial->shader = postprocessShader;
-            postprocessMaterial->texture = colorTarget;
-            postprocessMaterial->sampler = postprocessSampler;
-            // The default options are fine but we don't need to interact with the depth buffer
-            // so it is more performant to disable the depth mask
-            postprocessMaterial->pipelineState.depthMask = false;
-        }
+        // The scene may be rendered at a lower resolution then upscaled by the postprocess pass
+        resolution.initialize(config.value("resolutionScale", nlohmann::json()));
+        renderSize = windowSize;
+        sceneTarget = nullptr;
+
+        // Then we check if there is a postprocess chain in the configuration
+        // (If only the resolution is scaled, the chain is empty so the scene is just upscaled to the window)
+        // The framebuffer and its color & depth textures are taken from the render target pool every frame (see "render")
+        // since their size follows the resolution scale
+        postprocessEnabled = config.contains("postprocess") || resolution.getSettings().isEnabled();
+        if (postprocessEnabled)
+            postprocess.initialize(config.value("postprocess", nlohmann::json()));
     }
 
     void ForwardRenderer::destroy()
     {
+        // The handles and ids belong to objects that will be deleted with the assets
+        shaderUniforms.clear();
+        pipelineStates.clear();
+        shaderIds.clear();
+        materialIds.clear();
+        meshIds.clear();
+        materialKeys.clear();
+        lightVariantShaders.clear();
+        // Delete the light buffers
+        lightClusters.destroy();
+        // Delete the render targets and the queries of the resolution controller
+        sceneTarget = nullptr;
+        renderTargets.clear();
+        resolution.destroy();
+        // Delete the instance buffer
+        glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
         // Delete all objects related to the sky
         if (skyMaterial)
         {
@@ -113,40 +119,354 @@ namespace our
             delete skyMaterial;
         }
         // Delete all objects related to post processing
-        if (postprocessMaterial)
+        if (postprocessEnabled)
+            postprocess.destroy();
+        postprocessEnabled = false;
+    }
+
+    ShaderUniforms &ForwardRenderer::getShaderUniforms(ShaderProgram *shader)
+    {
+        if (auto it = shaderUniforms.find(shader); it != shaderUniforms.end())
+            return it->second;
+        // This is the first time we draw using this shader, so we resolve all the handles once
+        ShaderUniforms &uniforms = shaderUniforms[shader];
+        uniforms.transform = shader->getUniform<glm::mat4>("transform");
+        uniforms.objectToWorld = shader->getUniform<glm::mat4>("objectToWorld");
+        uniforms.objectToInvTranspose = shader->getUniform<glm::mat4>("objectToInvTranspose");
+        uniforms.cameraPosition = shader->getUniform<glm::vec3>("cameraPosition");
+        uniforms.viewProjection = shader->getUniform<glm::mat4>("VP");
+        // Lit shaders read the lights from the "Lights" block and the light buffer textures (the shader is in use at this point)
+        LightClusters::setupShader(shader);
+        return uniforms;
+    }
+
+    void ForwardRenderer::uploadLights(const glm::mat4 &view, const glm::mat4 &projection, const CameraComponent *camera)
+    {
+        //TODO: (Light) SEND THE LIST OF LIGHTS TO THE SHADER FOR LIGHTING SUPPORT
+        // Only the lights near each cluster of the view frustum are listed in it, so a fragment skips all the far lights
+        lightClusters.update(lights, view, projection, camera->near, camera->far, renderSize);
+        lightClusters.bind();
+        stats.lights = lightClusters.getStats();
+
+        // The lights rarely change, so the shaders are only looked up again when the light mix changes.
+        // The mix holds the exact number of directional lights (every fragment loops over all of them) but only whether there
+        // are point & spot lights, since their number per fragment depends on the cluster.
+        glm::ivec3 mix = lightClusters.getLightMix();
+        mix = glm::ivec3(mix.x, mix.y > 0, mix.z > 0);
+        if (mix != lightMix)
+        {
+            lightMix = mix;
+            lightMixDefines = {
+                {"DIRECTIONAL_LIGHT_COUNT", std::to_string(mix.x)},
+                {"POINT_LIGHTS", std::to_string(mix.y)},
+                {"SPOT_LIGHTS", std::to_string(mix.z)}};
+            lightVariantShaders.clear();
+        }
+    }
+
+    ShaderProgram *ForwardRenderer::getLightVariant(ShaderProgram *shader)
+    {
+        if (!lightVariants)
+            return shader;
+        auto it = lightVariantShaders.find(shader);
+        if (it == lightVariantShaders.end())
         {
-            glDeleteFramebuffers(1, &postprocessFrameBuffer);
-            glDeleteVertexArrays(1, &postProcessVertexArray);
-            delete colorTarget;
-            delete depthTarget;
-            delete postprocessMaterial->sampler;
-            delete postprocessMaterial->shader;
-            delete postprocessMaterial;
+            // The variant is compiled the first time a light mix is seen, then it stays owned by the shader for the next times
+            ShaderProgram *variant = shader->hasUniformBlock("Lights") ? shader->getVariant(lightMixDefines) : shader;
+            it = lightVariantShaders.emplace(shader, variant).first;
         }
+        return it->second;
     }
 
-    void ForwardRenderer::render(World *world)
+    uint64_t ForwardRenderer::getSortKey(const Material *material, const Mesh *mesh)
     {
+        // Returns the id of the given object, assigning a new one if this is the first time it is seen
+        auto getId = [](auto &ids, auto key)
+        {
+            return ids.emplace(key, (uint64_t)ids.size()).first->second;
+        };
+
+        auto it = materialKeys.find(material);
+        if (it == materialKeys.end())
+        {
+            // Materials with equal pipeline states share the same pipeline id
+            uint64_t pipelineId = 0;
+            while (pipelineId < pipelineStates.size() && pipelineStates[pipelineId] != material->pipelineState)
+                pipelineId++;
+            if (pipelineId == pipelineStates.size())
+                pipelineStates.push_back(material->pipelineState);
+            uint64_t shaderId = getId(shaderIds, (const ShaderProgram *)material->shader);
+            uint64_t materialId = getId(materialIds, material);
+            uint64_t key = ((pipelineId & 0xFF) << 56) | ((shaderId & 0xFFF) << 44) | ((materialId & 0xFFFFF) << 24);
+            it = materialKeys.emplace(material, key).first;
+        }
+        return it->second | (getId(meshIds, mesh) & 0xFFFFFF);
+    }
+
+    void ForwardRenderer::resetBoundState()
+    {
+        boundMaterial = nullptr;
+        boundPipeline = nullptr;
+        boundShader = nullptr;
+        boundMesh = nullptr;
+    }
+
+    void ForwardRenderer::drawCommand(const RenderCommand &command, const glm::mat4 &VP, const glm::vec3 &cameraPosition)
+    {
+        Material *material = command.material;
+        ShaderProgram *shader = getLightVariant(material->shader);
+        if (material != boundMaterial || shader != boundShader)
+        {
+            // Only apply the pipeline state and the shader if they differ from those of the previous material
+            if (boundPipeline && *boundPipeline == material->pipelineState)
+                stats.savedStateChanges++;
+            else
+            {
+                material->pipelineState.setup();
+                stats.pipelineChanges++;
+            }
+            if (shader == boundShader)
+                stats.savedStateChanges++;
+            else
+            {
+                shader->use();
+                stats.shaderChanges++;
+            }
+            // The material uniforms, textures and samplers are always sent when the material changes
+            material->setupUniforms(shader);
+            stats.materialChanges++;
+            boundMaterial = material;
+            boundPipeline = &material->pipelineState;
+            boundShader = shader;
+        }
+        else
+        {
+            // The same material was used by the previous command, so the pipeline, shader and material are all skipped
+            stats.savedStateChanges += 3;
+        }
+
+        ShaderUniforms &uniforms = getShaderUniforms(shader);
+
+        //TODO: (Light) SEND THE NEEDED TRANSFORMS TO THE SHADER FOR LIGHTING SUPPORT
+        // send the needed uniforms for the shaders (the lights are already in the light buffer)
+        shader->set(uniforms.transform, VP * command.localToWorld);
+        // pass mat4 that transforms local space to world space to calculate world vector
+        shader->set(uniforms.objectToWorld, command.localToWorld);
+        // mat4 that represents the object to world inverse transpose for the normal
+        // (it is only computed if the shader actually uses it)
+        if (uniforms.objectToInvTranspose.valid())
+            shader->set(uniforms.objectToInvTranspose, glm::transpose(glm::inverse(command.localToWorld)));
+        // send camera position for the view vector
+        shader->set(uniforms.cameraPosition, cameraPosition);
+
+        // Only bind the mesh if the previous command did not draw the same mesh
+        if (command.mesh != boundMesh)
+        {
+            command.mesh->bind();
+            boundMesh = command.mesh;
+            stats.meshChanges++;
+        }
+        else
+            stats.savedStateChanges++;
+        command.mesh->drawElements();
+        stats.drawCalls++;
+    }
+
+    void ForwardRenderer::buildOpaqueGroups()
+    {
+        opaqueGroups.clear();
+        instances.clear();
+        for (size_t first = 0; first < opaqueCommands.size();)
+        {
+            // Since the commands are sorted by their keys, the commands sharing the same mesh and material are consecutive
+            const RenderCommand &command = opaqueCommands[first];
+            size_t count = 1;
+            while (first + count < opaqueCommands.size() &&
+                   opaqueCommands[first + count].material == command.material &&
+                   opaqueCommands[first + count].mesh == command.mesh)
+                count++;
+
+            DrawGroup group{first, count, -1};
+            if (instancing && count >= MIN_INSTANCE_GROUP_SIZE && getLightVariant(command.material->shader)->getInstancedVariant())
+            {
+                // Pack the transforms of the group's commands after those of the previous groups
+                group.firstInstance = (GLint)instances.size();
+                for (size_t i = first; i < first + count; i++)
+                {
+                    const glm::mat4 &localToWorld = opaqueCommands[i].localToWorld;
+                    instances.push_back({localToWorld, glm::transpose(glm::inverse(localToWorld))});
+                }
+            }
+            opaqueGroups.push_back(group);
+            first += count;
+        }
+
+        if (instances.empty())
+            return;
+        // Orphan the previous content of the buffer (so that we don't wait for the draw calls of the last frame) then upload all the instances at once
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void ForwardRenderer::drawInstanced(const DrawGroup &group, const glm::mat4 &VP, const glm::vec3 &cameraPosition)
+    {
+        const RenderCommand &command = opaqueCommands[group.first];
+        Material *material = command.material;
+        ShaderProgram *program = getLightVariant(material->shader)->getInstancedVariant();
+        // The state is tracked exactly like "drawCommand" but the material is setup with the instanced variant of its shader
+        if (material != boundMaterial || program != boundShader)
+        {
+            if (boundPipeline && *boundPipeline == material->pipelineState)
+                stats.savedStateChanges++;
+            else
+            {
+                material->pipelineState.setup();
+                stats.pipelineChanges++;
+            }
+            if (program == boundShader)
+                stats.savedStateChanges++;
+            else
+            {
+                program->use();
+                stats.shaderChanges++;
+            }
+            material->setupUniforms(program);
+            stats.materialChanges++;
+            boundMaterial = material;
+            boundPipeline = &material->pipelineState;
+            boundShader = program;
+        }
+        else
+            stats.savedStateChanges += 3;
+
+        // The per object transforms come from the instance buffer so only the shared uniforms are sent
+        ShaderUniforms &uniforms = getShaderUniforms(program);
+        program->set(uniforms.viewProjection, VP);
+        program->set(uniforms.cameraPosition, cameraPosition);
+
+        // Point the instance attributes of the mesh's vertex array to the group's instances
+        // The mesh is always bound since the attribute offsets differ from one group to another
+        command.mesh->bind();
+        boundMesh = command.mesh;
+        stats.meshChanges++;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        size_t base = group.firstInstance * sizeof(InstanceData);
+        // A mat4 attribute is sent as 4 vec4 columns, each in its own location
+        for (GLuint column = 0; column < 4; column++)
+        {
+            GLuint location = ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, false, sizeof(InstanceData),
+                                  (void *)(base + offsetof(InstanceData, objectToWorld) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+
+            location = ATTRIB_LOC_INSTANCE_OBJECT_TO_INV_TRANSPOSE + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, false, sizeof(InstanceData),
+                                  (void *)(base + offsetof(InstanceData, objectToInvTranspose) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        command.mesh->drawElementsInstanced((GLsizei)group.count);
+
+        // The mesh is shared (and outlives the renderer in the asset cache), so its vertex array is restored as it was:
+        // otherwise its non-instanced draws would still read the instance arrays, and it would keep pointing at the
+        // instance buffer after it is deleted (a null pointer with no buffer bound detaches the buffer from the location)
+        for (GLuint column = 0; column < 4; column++)
+        {
+            for (GLuint location : {ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column, ATTRIB_LOC_INSTANCE_OBJECT_TO_INV_TRANSPOSE + column})
+            {
+                glDisableVertexAttribArray(location);
+                glVertexAttribDivisor(location, 0);
+                glVertexAttribPointer(location, 4, GL_FLOAT, false, 0, nullptr);
+            }
+        }
+        stats.drawCalls++;
+        stats.instancedDrawCalls++;
+        stats.instancedCommands += (unsigned int)group.count;
+    }
+
+    void ForwardRenderer::sortTransparentCommands(const glm::mat4 &view, float far)
+    {
+        // If the camera and all the transparent objects are where they were when the order was computed, we reuse it
+        bool unchanged = view == sortedView && sortedCenters.size() == transparentCommands.size();
+        for (size_t i = 0; unchanged && i < transparentCommands.size(); i++)
+            unchanged = sortedCenters[i] == transparentCommands[i].center;
+        stats.transparentOrderReused = unchanged;
+        if (unchanged)
+            return;
+
+        sortedView = view;
+        sortedCenters.resize(transparentCommands.size());
+        transparentOrder.resize(transparentCommands.size());
+        transparentKeys.resize(transparentCommands.size());
+        for (size_t i = 0; i < transparentCommands.size(); i++)
+        {
+            const glm::vec3 &center = transparentCommands[i].center;
+            sortedCenters[i] = center;
+            transparentOrder[i] = (uint32_t)i;
+            // The camera looks along -z in the view space, so the depth is the negated view space z
+            float depth = -(view[0][2] * center.x + view[1][2] * center.y + view[2][2] * center.z + view[3][2]);
+            // The depth is quantized to 32 bits over the range [0, far], then inverted so that the farthest command has the smallest key
+            double quantized = glm::clamp((double)depth / far, 0.0, 1.0) * 4294967295.0;
+            transparentKeys[i] = 0xFFFFFFFFu - (uint32_t)quantized;
+        }
+        radixSort(transparentKeys, transparentOrder, keyScratch, orderScratch);
+    }
+
+    void ForwardRenderer::render(World *world, float alpha)
+    {
+        PROFILE_SCOPE("ForwardRenderer");
         // First of all, we search for a camera and for all the mesh renderers
         CameraComponent *camera = nullptr;
         opaqueCommands.clear();
         transparentCommands.clear();
         //TODO: (Light) clear the list of lights
         lights.clear();
-        for (auto entity : world->getEntities())
+        // We use the first camera we find
+        for (auto [cameraComponent] : world->view<CameraComponent>())
+        {
+            camera = cameraComponent;
+            break;
+        }
+        // If there is no camera, we return (we cannot render without a camera)
+        if (camera == nullptr)
+            return;
+
+        // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
+        glm::mat4 VM = camera->getViewMatrix(alpha);
+        glm::mat4 P = camera->getProjectionMatrix(windowSize);
+        glm::mat4 VP = P * VM;
+        // The commands outside this frustum are not visible so they are skipped
+        Frustum frustum(VP);
+        stats = RenderStats();
+
+        // The measurements of the previous frames may change the resolution scale of this one
+        resolution.update();
+        stats.resolutionScale = postprocessEnabled ? resolution.getScale() : 1.0f;
+        stats.gpuMilliseconds = resolution.getGpuMilliseconds();
+
+        // Each visible mesh renderer component becomes a render command and each light component is collected
         {
-            // If we hadn't found a camera yet, we look for a camera in this entity
-            if (!camera)
-                camera = entity->getComponent<CameraComponent>();
-            // If this entity has a mesh renderer component
-            if (auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer)
+            PROFILE_SCOPE("Build Commands");
+            for (auto [meshRenderer] : world->view<MeshRendererComponent>())
             {
                 // We construct a command from it
                 RenderCommand command;
-                command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
+                command.localToWorld = meshRenderer->getOwner()->getInterpolatedLocalToWorldMatrix(alpha);
+                if (frustumCulling && !frustum.intersects(meshRenderer->mesh->getBounds(), command.localToWorld))
+                {
+                    stats.culledCommands++;
+                    continue;
+                }
+                stats.visibleCommands++;
                 command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
                 command.mesh = meshRenderer->mesh;
                 command.material = meshRenderer->material;
+                command.sortKey = getSortKey(command.material, command.mesh);
                 // if it is transparent, we add it to the transparent commands list
                 if (command.material->transparent)
                 {
@@ -160,32 +480,40 @@ namespace our
             }
             //TODO: (Light) push light components into the list of lights
             // fill the vector of lights with the light components to be used in the shaders
-            if (auto light = entity->getComponent<LightComponent>(); light)
+            for (auto [light] : world->view<LightComponent>())
             {
                 lights.push_back(light);
             }
         }
 
-        // If there is no camera, we return (we cannot render without a camera)
-        if (camera == nullptr)
-            return;
+        {
+            PROFILE_SCOPE("Sort Commands");
+            // The transparent commands are drawn back to front along the camera forward axis
+            sortTransparentCommands(VM, camera->far);
 
-        // TODO: (Req 9) Modify the following line such that "cameraForward" contains a vector pointing the camera forward direction
-        // HINT: See how you wrote the CameraComponent::getViewMatrix, it should help you solve this one
-        // glm::vec3 cameraForward = glm::vec3(0.0, 0.0, -1.0f);
-        glm::mat4 VM = camera->getViewMatrix();
-        glm::vec3 cameraForward = glm::vec3(VM[2][0], VM[2][1], VM[2][2]); // 3rd row
-        std::sort(transparentCommands.begin(), transparentCommands.end(), [cameraForward](const RenderCommand &first, const RenderCommand &second)
-                  {
-            //TODO: (Req 9) Finish this function
-            // HINT: the following return should return true "first" should be drawn before "second". 
-            return first.center.z < second.center.z; });
+            // The opaque commands can be drawn in any order, so we sort them by their keys to group the commands sharing the same state
+            std::sort(opaqueCommands.begin(), opaqueCommands.end(), [](const RenderCommand &first, const RenderCommand &second)
+                      { return first.sortKey < second.sortKey; });
+        }
 
-        // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
-        glm::mat4 VP = camera->getProjectionMatrix(windowSize) * camera->getViewMatrix();
+        // If there is a postprocess chain, the scene is drawn into a render target of the scaled size
+        // (the projection still uses the window size since the aspect ratio does not change)
+        if (postprocessEnabled)
+        {
+            glm::ivec2 size = glm::max(glm::ivec2(1), glm::ivec2(glm::round(glm::vec2(windowSize) * stats.resolutionScale)));
+            if (!sceneTarget || sceneTarget->size != size)
+            {
+                if (sceneTarget)
+                    renderTargets.release(sceneTarget);
+                sceneTarget = renderTargets.acquire(size);
+            }
+            renderSize = size;
+        }
+        else
+            renderSize = windowSize;
 
         // TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
-        glViewport(0, 0, windowSize.x, windowSize.y);
+        glViewport(0, 0, renderSize.x, renderSize.y);
 
         // TODO: (Req 9) Set the clear color to black and the clear depth to 1
         glClearColor(0.0, 0.0, 0.0, 0.0);
@@ -195,11 +523,14 @@ namespace our
         glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
         glDepthMask(GL_TRUE);
 
-        // If there is a postprocess material, bind the framebuffer
-        if (postprocessMaterial)
+        // The GPU time of the frame is measured from here to the end of the postprocess (to adjust the resolution scale)
+        resolution.beginFrame();
+
+        // If there is a postprocess chain, bind the framebuffer
+        if (postprocessEnabled)
         {
             // TODO: (Req 11) bind the framebuffer
-            glBindFramebuffer(GL_FRAMEBUFFER, postprocessFrameBuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget->framebuffer);
         }
 
         // TODO: (Req 9) Clear the color and depth buffers
@@ -208,70 +539,33 @@ namespace our
         // TODO: (Req 9) Draw all the opaque commands
         // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render
         // TODO: (Req 10) Get the camera position
-        glm::vec3 cameraPosition = camera->getOwner()->localTransform.position;
-        for (unsigned long int i = 0; i < opaqueCommands.size(); i++)
+        // The camera position is taken from the same interpolated transform used to build its view matrix
+        glm::vec3 cameraPosition = glm::vec3(camera->getOwner()->getInterpolatedLocalToWorldMatrix(alpha)[3]);
         {
-            opaqueCommands[i].material->transparent = false;
-            opaqueCommands[i].material->setup();
-
-            //TODO: (Light) SEND THE NEEDED TRANSFORMS TO THE SHADER FOR LIGHTING SUPPORT
-            // send the needed uniforms for the shaders
-            opaqueCommands[i].material->shader->set("transform", VP * opaqueCommands[i].localToWorld);
-            // pass mat4 that transforms local space to world space to calculate world vector
-            opaqueCommands[i].material->shader->set("objectToWorld", opaqueCommands[i].localToWorld);
-            // mat4 that represents the object to world inverse transpose for the normal
-            opaqueCommands[i].material->shader->set("objectToInvTranspose", glm::transpose(glm::inverse(opaqueCommands[i].localToWorld)));
-            // send camera position for the view vector
-            opaqueCommands[i].material->shader->set("cameraPosition", cameraPosition);
-
-            //TODO: (Light) SEND THE LIST OF LIGHTS TO THE SHADER FOR LIGHTING SUPPORT
-            // loop over all light sources and pass their data to the shaders
-            for (int j = 0; j < lights.size(); j++)
+            PROFILE_SCOPE("Opaque Pass");
+            PROFILE_GPU_SCOPE("Opaque Pass");
+            // The lights are the same for all the commands, so they are uploaded once per frame
+            uploadLights(VM, P, camera);
+            resetBoundState();
+            // The commands sharing the same mesh and material are drawn together using instancing (if possible)
+            buildOpaqueGroups();
+            for (const DrawGroup &group : opaqueGroups)
             {
-                // diffuse, specular and ambient for all light sources
-                opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "diffuse", lights[j]->diffuse);
-                opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "specular", lights[j]->specular);
-                opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "ambient", lights[j]->ambient);
-                // passing the light type point, directional or spot
-                opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "type", static_cast<int>(lights[j]->lightType));
-
-                // according to the light type pass the remaining parameters
-                switch (lights[j]->lightType)
-                {
-                case LightType::DIRECTIONAL:
-                    // in case of directional light pass the light's direction
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "direction", glm::normalize(lights[j]->getOwner()->localTransform.rotation));
-                    break;
-                case LightType::POINT:
-                    // in case of point light pass its positiins
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "position", lights[j]->getOwner()->localTransform.position);
-                    // and the attenuation factors
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_constant", lights[j]->attenuation_constant);
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_linear", lights[j]->attenuation_linear);
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_quadratic", lights[j]->attenuation_quadratic);
-                    break;
-                case LightType::SPOT:
-                    // in case of spot light pass its position and direction
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "position", lights[j]->getOwner()->localTransform.position);
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "direction", glm::normalize(lights[j]->getOwner()->localTransform.rotation));
-                    // its attenuation factors
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_constant", lights[j]->attenuation_constant);
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_linear", lights[j]->attenuation_linear);
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_quadratic", lights[j]->attenuation_quadratic);
-                    // and cone angles
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "inner_angle", lights[j]->inner_angle);
-                    opaqueCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "outer_angle", lights[j]->outer_angle);
-                    break;
-                }
+                opaqueCommands[group.first].material->transparent = false;
+                if (group.firstInstance >= 0)
+                    drawInstanced(group, VP, cameraPosition);
+                else
+                    for (size_t i = group.first; i < group.first + group.count; i++)
+                        drawCommand(opaqueCommands[i], VP, cameraPosition);
             }
-            // lastly pass the light count to be used in shaders when looping over the lights
-            opaqueCommands[i].material->shader->set("light_count", (GLint)lights.size());
-            opaqueCommands[i].mesh->draw();
+            glBindVertexArray(0);
         }
 
         // If there is a sky material, draw the sky
         if (this->skyMaterial)
         {
+            PROFILE_SCOPE("Sky");
+            PROFILE_GPU_SCOPE("Sky");
             // TODO: (Req 10) setup the sky material
             skyMaterial->setup();
             // TODO: (Req 10) Create a model matrix for the sky such that it always follows the camera (sky sphere center = camera position)
@@ -295,76 +589,32 @@ namespace our
         }
         // TODO: (Req 9) Draw all the transparent commands
         // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        for (unsigned long int i = 0; i < transparentCommands.size(); i++)
+        // The sky changed the OpenGL state so we cannot rely on the state set by the opaque commands
         {
-            transparentCommands[i].material->transparent = true;
-            transparentCommands[i].material->setup();
-            //TODO: (Light) SEND THE NEEDED TRANSFORMS TO THE SHADER FOR LIGHTING SUPPORT
-            // send the needed uniforms for the shaders
-            transparentCommands[i].material->shader->set("transform", VP * transparentCommands[i].localToWorld);
-            // pass mat4 that transforms local space to world space to calculate world vector
-            transparentCommands[i].material->shader->set("objectToWorld", transparentCommands[i].localToWorld);
-            // mat4 that represents the object to world inverse transpose for the normal
-            transparentCommands[i].material->shader->set("objectToInvTranspose", glm::transpose(glm::inverse(transparentCommands[i].localToWorld)));
-            // send camera position for the view vector
-            transparentCommands[i].material->shader->set("cameraPosition", cameraPosition);
-
-            //TODO: (Light) SEND THE LIST OF LIGHTS TO THE SHADER FOR LIGHTING SUPPORT 
-            // loop over all light sources and pass their data to the shaders
-            for (int j = 0; j < lights.size(); j++)
+            PROFILE_SCOPE("Transparent Pass");
+            PROFILE_GPU_SCOPE("Transparent Pass");
+            resetBoundState();
+            for (uint32_t index : transparentOrder)
             {
-                // diffuse, specular and ambient for all light sources
-                transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "diffuse", lights[j]->diffuse);
-                transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "specular", lights[j]->specular);
-                transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "ambient", lights[j]->ambient);
-                // passing the light type point, directional or spot
-                transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "type", static_cast<int>(lights[j]->lightType));
-
-                // according to the light type pass the remaining parameters
-                switch (lights[j]->lightType)
-                {
-                case LightType::DIRECTIONAL:
-                    // in case of directional light pass the light's direction
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "direction", glm::normalize(lights[j]->getOwner()->localTransform.rotation));
-                    break;
-                case LightType::POINT:
-                    // in case of point light pass its positiins
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "position", lights[j]->getOwner()->localTransform.position);
-                    // and the attenuation factors
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_constant", lights[j]->attenuation_constant);
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_linear", lights[j]->attenuation_linear);
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_quadratic", lights[j]->attenuation_quadratic);
-                    break;
-                case LightType::SPOT:
-                    // in case of spot light pass its position and direction
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "position", lights[j]->getOwner()->localTransform.position);
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "direction", glm::normalize(lights[j]->getOwner()->localTransform.rotation));
-                    // its attenuation factors
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_constant", lights[j]->attenuation_constant);
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_linear", lights[j]->attenuation_linear);
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "attenuation_quadratic", lights[j]->attenuation_quadratic);
-                    // and cone angles
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "inner_angle", lights[j]->inner_angle);
-                    transparentCommands[i].material->shader->set("lights[" + std::to_string(j) + "]." + "outer_angle", lights[j]->outer_angle);
-                    break;
-                }
+                transparentCommands[index].material->transparent = true;
+                drawCommand(transparentCommands[index], VP, cameraPosition);
             }
-            // lastly pass the light count to be used in shaders when looping over the lights
-            transparentCommands[i].material->shader->set("light_count", (GLint)lights.size());
-            transparentCommands[i].mesh->draw();
+            glBindVertexArray(0);
         }
 
-        // If there is a postprocess material, apply postprocessing
-        if (postprocessMaterial)
+        // If there is a postprocess chain, apply postprocessing
+        if (postprocessEnabled)
         {
-            // TODO: (Req 11) Return to the default framebuffer
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            // TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
-            postprocessMaterial->setup();
-            glBindVertexArray(postProcessVertexArray);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-            glBindVertexArray(0);
+            PROFILE_SCOPE("Postprocess");
+            PROFILE_GPU_SCOPE("Postprocess");
+            // The passes of the chain read the scene target and the last one is drawn to the default framebuffer
+            // covering the whole window, so the scene is upscaled by the linear sampler
+            postprocess.apply(sceneTarget->color, renderSize, windowSize, renderTargets);
+            stats.postprocess = postprocess.getStats();
         }
+        resolution.endFrame();
+
+        renderTargets.endFrame();
     }
 
 }
\ No newline at end of file
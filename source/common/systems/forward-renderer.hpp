@@ -5,11 +5,18 @@
 #include "../components/mesh-renderer.hpp"
 #include "../components/light.hpp"
 #include "../asset-loader.hpp"
+#include "frustum.hpp"
+#include "radix-sort.hpp"
+#include "light-clusters.hpp"
+#include "dynamic-resolution.hpp"
+#include "postprocess-chain.hpp"
 
 #include <glad/gl.h>
 #include <vector>
 #include <algorithm>
 #include <utility>
+#include <unordered_map>
+#include <cstdint>
 
 namespace our
 {
@@ -22,6 +29,51 @@ namespace our
         glm::vec3 center;
         Mesh* mesh;
         Material* material;
+        // The opaque commands are sorted by this key so that the commands sharing the same state are drawn consecutively.
+        // From the most to the least significant bits, it holds: pipeline state id (8 bits), shader id (12 bits),
+        // material id (20 bits) and mesh id (24 bits). So the most expensive state changes are the least frequent.
+        uint64_t sortKey;
+    };
+
+    // Statistics about the state changes done by the renderer during the last frame
+    struct RenderStats {
+        unsigned int drawCalls = 0;
+        unsigned int pipelineChanges = 0, shaderChanges = 0, materialChanges = 0, meshChanges = 0;
+        // The number of pipeline, shader, material & mesh changes that were skipped
+        // because the previous command already set the same state
+        unsigned int savedStateChanges = 0;
+        // The number of instanced draw calls (they are also counted in "drawCalls") and the commands they drew
+        unsigned int instancedDrawCalls = 0, instancedCommands = 0;
+        // The number of commands that were inside the camera frustum and the number that were skipped because they were outside it
+        unsigned int visibleCommands = 0, culledCommands = 0;
+        // True if the transparent commands were drawn in the order sorted in a previous frame (since nothing moved)
+        bool transparentOrderReused = false;
+        // The statistics of the clustered light culling
+        LightClusterStats lights;
+        // The scale of the scene resolution relative to the window and the smoothed GPU time measured by the resolution controller
+        // (negative if the scale is not automatic)
+        float resolutionScale = 1.0f;
+        double gpuMilliseconds = -1.0;
+        // The passes drawn by the postprocess chain and their traffic
+        PostprocessStats postprocess;
+    };
+
+    // The data of a single instance as it is laid out in the instance buffer.
+    // It is read by the instanced shader variants at ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD and ATTRIB_LOC_INSTANCE_OBJECT_TO_INV_TRANSPOSE
+    struct InstanceData {
+        glm::mat4 objectToWorld;
+        glm::mat4 objectToInvTranspose;
+    };
+
+    // The minimum number of consecutive opaque commands sharing the same mesh and material that are drawn using a single instanced draw call
+    constexpr size_t MIN_INSTANCE_GROUP_SIZE = 2;
+
+    // The handles of the uniforms that the renderer sends for every command.
+    // They are resolved once per shader so that drawing a command requires no string building or uniform lookups.
+    struct ShaderUniforms {
+        Uniform<glm::mat4> transform, objectToWorld, objectToInvTranspose;
+        Uniform<glm::mat4> viewProjection; // Only used by the instanced variants ("VP")
+        Uniform<glm::vec3> cameraPosition;
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
@@ -35,17 +87,98 @@ namespace our
         // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
+        // The transparent commands are drawn from the farthest to the nearest in this order (indices into "transparentCommands").
+        // The commands are not moved: only their indices are radix sorted by the keys computed from their view depths.
+        std::vector<uint32_t> transparentOrder, transparentKeys;
+        std::vector<uint32_t> orderScratch, keyScratch; // The second buffers of the radix sort
+        // The camera view & the command centers from which "transparentOrder" was computed.
+        // If they did not change, the order is still valid and the sort is skipped.
+        glm::mat4 sortedView = glm::mat4(0.0f);
+        std::vector<glm::vec3> sortedCenters;
         //TODO: (Light) Add List of lights in the scene
         //List of lights in the scene
         std::vector<LightComponent*> lights;
+        // The lights are binned into the clusters of the camera frustum then uploaded once per frame
+        // The grid & the cutoff can be set from the config using "lightClusters" (see "LightClusters::initialize")
+        LightClusters lightClusters;
+        // If true, the shaders that read the "Lights" block are replaced by their variants compiled for the light mix of the frame,
+        // so their loops only run over the lights of each type that the frame has (see "assets/shaders/common/lights.glsl").
+        // It can be disabled from the config using "lightVariants": false
+        bool lightVariants = true;
+        // The number of directional lights of the frame and whether it has point & spot lights, and the matching defines
+        glm::ivec3 lightMix = glm::ivec3(-1);
+        ShaderDefines lightMixDefines;
+        // The shader used for each material shader with the current light mix (it is cleared whenever the light mix changes)
+        std::unordered_map<ShaderProgram*, ShaderProgram*> lightVariantShaders;
         //std::vector<std::pair<glm::vec3, glm::vec3>> lights_position_direction;
         // Objects used for rendering a skybox
         Mesh* skySphere;
         TexturedMaterial* skyMaterial;
-        // Objects used for Postprocessing
-        GLuint postprocessFrameBuffer, postProcessVertexArray;
-        Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial* postprocessMaterial;
+        // Postprocessing is done by a chain of effects which can be set from the config using "postprocess" (see "PostprocessChain")
+        PostprocessChain postprocess;
+        bool postprocessEnabled = false;
+        // The scene is drawn into "sceneTarget" whose size is the window size scaled by the resolution scale,
+        // then the postprocess chain upscales it to the window. The targets come from a pool since the size changes with the scale.
+        // The scale can be set from the config using "resolutionScale" (see "ResolutionSettings")
+        RenderTargetPool renderTargets;
+        RenderTarget* sceneTarget = nullptr;
+        ResolutionController resolution;
+        // The size of the scene (the window size unless it is drawn into a scaled render target)
+        glm::ivec2 renderSize;
+        // If true, the opaque commands sharing the same mesh and material are drawn using instancing
+        // (if their shader has an instanced variant). It can be disabled from the config using "instancing": false
+        bool instancing = true;
+        // If true, the commands whose mesh bounds are outside the camera frustum are not drawn.
+        // It can be disabled from the config using "frustumCulling": false
+        bool frustumCulling = true;
+        // A group of consecutive opaque commands that are drawn together (or one by one if "firstInstance" is -1)
+        struct DrawGroup {
+            size_t first, count;
+            GLint firstInstance;
+        };
+        std::vector<DrawGroup> opaqueGroups;
+        // The data of all the instanced groups is packed into this vector then uploaded to "instanceBuffer" once per frame
+        std::vector<InstanceData> instances;
+        GLuint instanceBuffer = 0;
+        // The uniform handles of every shader used by the render commands (resolved the first time the shader is drawn)
+        std::unordered_map<ShaderProgram*, ShaderUniforms> shaderUniforms;
+
+        // The small ids used to build the sort keys. They are assigned the first time each object is seen.
+        std::vector<PipelineState> pipelineStates; // The distinct pipeline states (the id is the index)
+        std::unordered_map<const ShaderProgram*, uint64_t> shaderIds;
+        std::unordered_map<const Material*, uint64_t> materialIds;
+        std::unordered_map<const Mesh*, uint64_t> meshIds;
+        std::unordered_map<const Material*, uint64_t> materialKeys; // The pipeline, shader & material bits of each material's key
+
+        // The state set by the last drawn command, it is used to skip redundant state changes
+        const Material* boundMaterial;
+        const PipelineState* boundPipeline;
+        const ShaderProgram* boundShader;
+        const Mesh* boundMesh;
+        RenderStats stats;
+
+        // Computes the sort key of a command drawing the given mesh with the given material
+        uint64_t getSortKey(const Material* material, const Mesh* mesh);
+        // Forgets the bound state. This must be called whenever something else changes the OpenGL state (e.g. the sky)
+        void resetBoundState();
+
+        // Returns the uniform handles of the given shader (resolving them if this is the first time we see this shader)
+        ShaderUniforms& getShaderUniforms(ShaderProgram* shader);
+        // Bins the lights of the current frame into the clusters of the camera and uploads them
+        // Then the light mix is updated (and the shaders of the previous mix are forgotten if it changed)
+        void uploadLights(const glm::mat4& view, const glm::mat4& projection, const CameraComponent* camera);
+        // Returns the variant of the given shader for the current light mix (or the shader itself if it doesn't read the lights)
+        ShaderProgram* getLightVariant(ShaderProgram* shader);
+        // Sets up the command's material, sends the transforms to its shader then draws its mesh
+        // The pipeline state, shader, material and mesh are only set if they differ from the previous command
+        void drawCommand(const RenderCommand& command, const glm::mat4& VP, const glm::vec3& cameraPosition);
+        // Sorts the transparent commands back to front by their depth along the camera forward axis (from 0 to "far")
+        // The result is stored in "transparentOrder"
+        void sortTransparentCommands(const glm::mat4& view, float far);
+        // Splits the sorted opaque commands into groups and uploads the instance data of the groups that will be instanced
+        void buildOpaqueGroups();
+        // Draws all the commands of the group using a single instanced draw call
+        void drawInstanced(const DrawGroup& group, const glm::mat4& VP, const glm::vec3& cameraPosition);
     public:
         // Initialize the renderer including the sky and the Postprocessing objects.
         // windowSize is the width & height of the window (in pixels).
@@ -53,7 +186,11 @@ namespace our
         // Clean up the renderer
         void destroy();
         // This function should be called every frame to draw the given world
-        void render(World* world);
+        // "alpha" is how far the frame is between the last two simulation steps (see "State::onRender").
+        // The entities are drawn between their previous and current transforms accordingly.
+        void render(World* world, float alpha = 1.0f);
+        // Returns the statistics of the last rendered frame
+        const RenderStats& getStats() const { return stats; }
 
 
     };
@@ -5,11 +5,13 @@
 #include "../components/free-camera-controller.hpp"
 
 #include "../application.hpp"
+#include "../profiler.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/trigonometric.hpp>
 #include <glm/gtx/fast_trigonometry.hpp>
+#include <utility>
 
 namespace our
 {
@@ -27,17 +29,29 @@ namespace our
             this->app = app;
         }
 
+        // Searches for an entity containing both a CameraComponent and a FreeCameraControllerComponent
+        // As soon as we find one, we return it. If there is none, both pointers are null.
+        static std::pair<CameraComponent*, FreeCameraControllerComponent*> findCamera(World* world) {
+            for(auto [cameraComponent, controllerComponent] : world->view<CameraComponent, FreeCameraControllerComponent>()){
+                return {cameraComponent, controllerComponent};
+            }
+            return {nullptr, nullptr};
+        }
+
         // This should be called every frame to update all entities containing a FreeCameraControllerComponent 
+        // It is the same as calling "look" then "move"
         void update(World* world, float deltaTime) {
-            // First of all, we search for an entity containing both a CameraComponent and a FreeCameraControllerComponent
-            // As soon as we find one, we break
-            CameraComponent* camera = nullptr;
-            FreeCameraControllerComponent *controller = nullptr;
-            for(auto entity : world->getEntities()){
-                camera = entity->getComponent<CameraComponent>();
-                controller = entity->getComponent<FreeCameraControllerComponent>();
-                if(camera && controller) break;
-            }
+            look(world);
+            move(world, deltaTime);
+        }
+
+        // This applies the mouse input (rotation & fov) and should be called once per frame.
+        // The mouse delta is the movement since the last frame, so it should not be applied more than once per frame
+        // even if the simulation runs many steps per frame. The rotation is also applied to the previous transform so that
+        // looking around is never delayed by the interpolation between the simulation steps.
+        void look(World* world) {
+            PROFILE_SCOPE("FreeCameraControllerSystem::look");
+            auto [camera, controller] = findCamera(world);
             // If there is no entity with both a CameraComponent and a FreeCameraControllerComponent, we can do nothing so we return
             if(!(camera && controller)) return;
             // Get the entity that we found via getOwner of camera (we could use controller->getOwner())
@@ -53,29 +67,39 @@ namespace our
                 mouse_locked = false;
             }
 
-            // We get a reference to the entity's position and rotation
-            glm::vec3& position = entity->localTransform.position;
-            glm::vec3& rotation = entity->localTransform.rotation;
-
             // If the left mouse button is pressed, we get the change in the mouse location
             // and use it to update the camera rotation
+            glm::vec2 delta = glm::vec2(0.0f);
             if(app->getMouse().isPressed(GLFW_MOUSE_BUTTON_1)){
-                glm::vec2 delta = app->getMouse().getMouseDelta();
-                rotation.x -= delta.y * controller->rotationSensitivity; // The y-axis controls the pitch CHECK THIS
-                rotation.y -= delta.x * controller->rotationSensitivity; // The x-axis controls the yaw
+                delta = app->getMouse().getMouseDelta();
+            }
+            for(glm::vec3* rotation : {&entity->localTransform.rotation, &entity->previousTransform.rotation}){
+                rotation->x -= delta.y * controller->rotationSensitivity; // The y-axis controls the pitch CHECK THIS
+                rotation->y -= delta.x * controller->rotationSensitivity; // The x-axis controls the yaw
+
+                // We prevent the pitch from exceeding a certain angle from the XZ plane to prevent gimbal locks
+                if(rotation->x < -glm::half_pi<float>() * 0.99f) rotation->x = -glm::half_pi<float>() * 0.99f;
+                if(rotation->x >  glm::half_pi<float>() * 0.99f) rotation->x  = glm::half_pi<float>() * 0.99f;
+                // This is not necessary, but whenever the rotation goes outside the 0 to 2*PI range, we wrap it back inside.
+                // This could prevent floating point error if the player rotates in single direction for an extremely long time. 
+                rotation->y = glm::wrapAngle(rotation->y);
             }
-
-            // We prevent the pitch from exceeding a certain angle from the XZ plane to prevent gimbal locks
-            if(rotation.x < -glm::half_pi<float>() * 0.99f) rotation.x = -glm::half_pi<float>() * 0.99f;
-            if(rotation.x >  glm::half_pi<float>() * 0.99f) rotation.x  = glm::half_pi<float>() * 0.99f;
-            // This is not necessary, but whenever the rotation goes outside the 0 to 2*PI range, we wrap it back inside.
-            // This could prevent floating point error if the player rotates in single direction for an extremely long time. 
-            rotation.y = glm::wrapAngle(rotation.y);
 
             // We update the camera fov based on the mouse wheel scrolling amount
             float fov = camera->fovY + app->getMouse().getScrollOffset().y * controller->fovSensitivity;
             fov = glm::clamp(fov, glm::pi<float>() * 0.01f, glm::pi<float>() * 0.99f); // We keep the fov in the range 0.01*PI to 0.99*PI
             camera->fovY = fov;
+        }
+
+        // This moves the camera using the keyboard input. It can be called at a fixed rate (see "State::onUpdate").
+        void move(World* world, float deltaTime) {
+            PROFILE_SCOPE("FreeCameraControllerSystem::move");
+            auto [camera, controller] = findCamera(world);
+            if(!(camera && controller)) return;
+            Entity* entity = camera->getOwner();
+
+            // We get a reference to the entity's position
+            glm::vec3& position = entity->localTransform.position;
 
             // We get the camera model matrix (relative to its parent) to compute the front, up and right directions
             glm::mat4 matrix = entity->localTransform.toMat4();
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+
+#include <glm/glm.hpp>
+
+namespace our
+{
+
+    // The 6 planes bounding the volume seen by a camera. Each plane is stored as (normal, distance) where the normal points inside
+    // the frustum, so a point p is inside the plane if dot(normal, p) + distance >= 0.
+    // The planes are extracted directly from the view projection matrix (Gribb & Hartmann), so they are in world space.
+    struct Frustum {
+        glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+        Frustum() = default;
+
+        explicit Frustum(const glm::mat4& VP) {
+            // GLM matrices are column major, so we first transpose it to access the rows
+            glm::mat4 rows = glm::transpose(VP);
+            planes[0] = rows[3] + rows[0];
+            planes[1] = rows[3] - rows[0];
+            planes[2] = rows[3] + rows[1];
+            planes[3] = rows[3] - rows[1];
+            planes[4] = rows[3] + rows[2];
+            planes[5] = rows[3] - rows[2];
+            // We normalize the planes so that the distances are in world units (which is needed to test spheres)
+            for(glm::vec4& plane : planes)
+                plane /= glm::length(glm::vec3(plane));
+        }
+
+        // Returns false if the sphere is completely outside the frustum
+        bool intersectsSphere(const glm::vec3& center, float radius) const {
+            for(const glm::vec4& plane : planes)
+                if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                    return false;
+            return true;
+        }
+
+        // Returns false if the box (given in the local space of the localToWorld matrix) is completely outside the frustum.
+        // The box is not transformed to 8 world space corners. Instead, for each plane we find the extent of the transformed
+        // box along the plane normal (using the absolute values of the matrix) and compare it to the distance of the box center.
+        bool intersectsBox(const MeshBounds& bounds, const glm::mat4& localToWorld) const {
+            glm::vec3 center = glm::vec3(localToWorld * glm::vec4(bounds.getCenter(), 1.0f));
+            glm::vec3 extents = (bounds.max - bounds.min) * 0.5f;
+            // The world space axes of the box scaled by its half extents
+            glm::vec3 axisX = glm::vec3(localToWorld[0]) * extents.x;
+            glm::vec3 axisY = glm::vec3(localToWorld[1]) * extents.y;
+            glm::vec3 axisZ = glm::vec3(localToWorld[2]) * extents.z;
+            for(const glm::vec4& plane : planes){
+                glm::vec3 normal = glm::vec3(plane);
+                float radius = glm::abs(glm::dot(normal, axisX)) + glm::abs(glm::dot(normal, axisY)) + glm::abs(glm::dot(normal, axisZ));
+                if(glm::dot(normal, center) + plane.w < -radius)
+                    return false;
+            }
+            return true;
+        }
+
+        // Tests the bounds of a mesh drawn using the given localToWorld matrix.
+        // The cheap sphere test runs first and the box test is only needed when the sphere intersects the frustum.
+        bool intersects(const MeshBounds& bounds, const glm::mat4& localToWorld) const {
+            glm::vec3 center = glm::vec3(localToWorld * glm::vec4(bounds.getCenter(), 1.0f));
+            // The sphere is scaled by the largest scale of the matrix so that it still encloses the mesh after a non uniform scale
+            float scale = glm::sqrt(glm::max(glm::max(
+                glm::dot(glm::vec3(localToWorld[0]), glm::vec3(localToWorld[0])),
+                glm::dot(glm::vec3(localToWorld[1]), glm::vec3(localToWorld[1]))),
+                glm::dot(glm::vec3(localToWorld[2]), glm::vec3(localToWorld[2]))));
+            if(!intersectsSphere(center, bounds.radius * scale)) return false;
+            return intersectsBox(bounds, localToWorld);
+        }
+    };
+
+}
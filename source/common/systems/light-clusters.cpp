@@ -0,0 +1,341 @@
+#include "light-clusters.hpp"
+#include "../ecs/entity.hpp"
+#include "../profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace our
+{
+
+    namespace
+    {
+
+        // The largest light index that fits in the 16-bit light lists
+        constexpr size_t MAX_CLUSTERED_LIGHTS = 0xFFFF;
+
+        float maxComponent(const glm::vec3 &color)
+        {
+            return std::max(color.r, std::max(color.g, color.b));
+        }
+
+        // Orphans the previous content of the buffer (so that we don't wait for the draw calls of the last frame) then uploads the data
+        // A buffer texture cannot be empty, so the buffer always holds at least a few bytes
+        void uploadBuffer(GLuint buffer, const void *data, size_t size)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+            if (size > 0)
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        }
+
+    }
+
+    void LightClusters::initialize(const nlohmann::json &config)
+    {
+        if (config.is_object())
+        {
+            if (auto it = config.find("grid"); it != config.end() && it->is_array() && it->size() == 3)
+                gridSize = glm::max(glm::ivec3(1), glm::ivec3((*it)[0].get<int>(), (*it)[1].get<int>(), (*it)[2].get<int>()));
+            cutoff = std::max(config.value("cutoff", cutoff), 1e-6f);
+        }
+        clusterBounds.clear();
+        boundsProjection = glm::mat4(0.0f);
+
+        // Each list lives in a buffer that is read by the shaders through a buffer texture of the matching format
+        auto createBufferTexture = [](GLuint &buffer, GLuint &texture, GLenum format)
+        {
+            glGenBuffers(1, &buffer);
+            uploadBuffer(buffer, nullptr, 0);
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        };
+        createBufferTexture(dataBuffer, dataTexture, GL_RGBA32F);
+        createBufferTexture(rangeBuffer, rangeTexture, GL_RG32UI);
+        createBufferTexture(indexBuffer, indexTexture, GL_R16UI);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glGenBuffers(1, &blockBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, blockBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void LightClusters::destroy()
+    {
+        GLuint textures[] = {dataTexture, rangeTexture, indexTexture};
+        GLuint buffers[] = {dataBuffer, rangeBuffer, indexBuffer, blockBuffer};
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(4, buffers);
+        dataTexture = rangeTexture = indexTexture = 0;
+        dataBuffer = rangeBuffer = indexBuffer = blockBuffer = 0;
+    }
+
+    void LightClusters::buildClusterBounds(const glm::mat4 &projection, float near, float far, glm::ivec2 viewportSize)
+    {
+        boundsProjection = projection;
+        boundsViewport = viewportSize;
+        clusterBounds.resize((size_t)gridSize.x * gridSize.y * gridSize.z);
+        // The tiles are rounded up so that the last tiles may go beyond the viewport edges
+        tileSize = glm::ceil(glm::vec2(viewportSize) / glm::vec2(gridSize.x, gridSize.y));
+        // The slice of a depth "d" is floor(log(d / near) / log(far / near) * gridSize.z)
+        logScale = gridSize.z / std::log(far / near);
+        logBias = -std::log(near) * logScale;
+
+        // Each screen position is the ray between its points on the near & far planes (which works for both projection types)
+        glm::mat4 inverse = glm::inverse(projection);
+        auto unproject = [&](float x, float y, float z)
+        {
+            glm::vec4 point = inverse * glm::vec4(x, y, z, 1.0f);
+            return glm::vec3(point) / point.w;
+        };
+        for (int y = 0; y < gridSize.y; y++)
+        {
+            for (int x = 0; x < gridSize.x; x++)
+            {
+                // The rays through the 4 corners of the tile
+                glm::vec3 nearPoints[4], farPoints[4];
+                for (int corner = 0; corner < 4; corner++)
+                {
+                    glm::vec2 pixel = glm::vec2(x + (corner & 1), y + (corner >> 1)) * tileSize;
+                    glm::vec2 ndc = pixel / glm::vec2(viewportSize) * 2.0f - 1.0f;
+                    nearPoints[corner] = unproject(ndc.x, ndc.y, -1.0f);
+                    farPoints[corner] = unproject(ndc.x, ndc.y, 1.0f);
+                }
+                for (int z = 0; z < gridSize.z; z++)
+                {
+                    // The depth range of the slice then the box around the points where the corner rays cross its bounds
+                    float depths[2] = {near * std::pow(far / near, (float)z / gridSize.z),
+                                       near * std::pow(far / near, (float)(z + 1) / gridSize.z)};
+                    ClusterBounds &bounds = clusterBounds[x + (size_t)gridSize.x * (y + (size_t)gridSize.y * z)];
+                    bounds.min = glm::vec3(std::numeric_limits<float>::max());
+                    bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        for (float depth : depths)
+                        {
+                            const glm::vec3 &n = nearPoints[corner], &f = farPoints[corner];
+                            float t = (depth + n.z) / (n.z - f.z);
+                            glm::vec3 point = n + (f - n) * t;
+                            bounds.min = glm::min(bounds.min, point);
+                            bounds.max = glm::max(bounds.max, point);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void LightClusters::binSphere(uint16_t light, const glm::vec3 &center, float radius, const glm::mat4 &projection, float near, float far, glm::ivec2 viewportSize)
+    {
+        // The view looks along -z, so the depth of the center is -z
+        float depth = -center.z;
+        if (depth + radius < near || depth - radius > far)
+            return;
+        auto slice = [&](float d)
+        { return std::clamp((int)std::floor(std::log(d) * logScale + logBias), 0, gridSize.z - 1); };
+        int z0 = slice(std::max(depth - radius, near)), z1 = slice(std::min(depth + radius, far));
+
+        // If the sphere is entirely in front of the near plane, the tiles are limited to the projection of its bounding box.
+        // Otherwise, its projection is unbounded so every tile of the slices is tested.
+        glm::ivec2 first(0), last(gridSize.x - 1, gridSize.y - 1);
+        if (depth - radius > near)
+        {
+            glm::vec2 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 offset = glm::vec3(corner & 1 ? 1 : -1, corner & 2 ? 1 : -1, corner & 4 ? 1 : -1) * radius;
+                glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                low = glm::min(low, ndc);
+                high = glm::max(high, ndc);
+            }
+            if (low.x > 1 || low.y > 1 || high.x < -1 || high.y < -1)
+                return;
+            glm::vec2 size(viewportSize);
+            first = glm::max(glm::ivec2(0), glm::ivec2(glm::floor((low * 0.5f + 0.5f) * size / tileSize)));
+            last = glm::min(glm::ivec2(gridSize.x - 1, gridSize.y - 1), glm::ivec2(glm::floor((high * 0.5f + 0.5f) * size / tileSize)));
+        }
+
+        // Then each candidate cluster is kept if its box is within the radius of the sphere center
+        float squaredRadius = radius * radius;
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int y = first.y; y <= last.y; y++)
+            {
+                for (int x = first.x; x <= last.x; x++)
+                {
+                    uint32_t cluster = x + (uint32_t)gridSize.x * (y + (uint32_t)gridSize.y * z);
+                    const ClusterBounds &bounds = clusterBounds[cluster];
+                    glm::vec3 offset = glm::clamp(center, bounds.min, bounds.max) - center;
+                    if (glm::dot(offset, offset) <= squaredRadius)
+                        binned.emplace_back(cluster, light);
+                }
+            }
+        }
+    }
+
+    float LightClusters::getLightRange(const LightComponent *light) const
+    {
+        // The lit shaders scale the light colors by 1 / (constant + linear * d + quadratic * d^2), so we look for the distance
+        // at which the brightest color of the light is scaled down to the cutoff
+        float intensity = std::max(maxComponent(light->diffuse), std::max(maxComponent(light->specular), maxComponent(light->ambient)));
+        if (intensity <= 0)
+            return 0;
+        float c = light->attenuation_constant - intensity / cutoff;
+        float b = light->attenuation_linear, a = light->attenuation_quadratic;
+        if (c >= 0)
+            return 0;
+        if (a > 0)
+            return (-b + std::sqrt(b * b - 4 * a * c)) / (2 * a);
+        if (b > 0)
+            return -c / b;
+        return std::numeric_limits<float>::infinity();
+    }
+
+    void LightClusters::update(const std::vector<LightComponent *> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                               float near, float far, glm::ivec2 viewportSize)
+    {
+        PROFILE_SCOPE("Light Culling");
+        // The slices are logarithmic so the near plane must be in front of the camera
+        near = std::max(near, 1e-3f);
+        far = std::max(far, near * 1.001f);
+        viewportSize = glm::max(viewportSize, glm::ivec2(1));
+        size_t clusterCount = (size_t)gridSize.x * gridSize.y * gridSize.z;
+        if (projection != boundsProjection || viewportSize != boundsViewport || clusterBounds.size() != clusterCount)
+            buildClusterBounds(projection, near, far, viewportSize);
+
+        stats = LightClusterStats();
+        stats.lights = (unsigned int)lights.size();
+        lightData.clear();
+        binned.clear();
+        lightMix = glm::ivec3(0);
+        block.ambient = glm::vec3(0.0f);
+
+        auto pack = [&](const LightComponent *light)
+        {
+            LightData data = {};
+            // diffuse, specular and ambient for all light sources
+            data.diffuse = light->diffuse;
+            data.specular = light->specular;
+            data.ambient = light->ambient;
+            // passing the light type point, directional or spot
+            data.type = (GLfloat)light->lightType;
+            // the position is used by point and spot lights while the direction is used by directional and spot lights
+            data.position = light->getOwner()->localTransform.position;
+            data.direction = glm::normalize(light->getOwner()->localTransform.rotation);
+            // the attenuation factors are used by point and spot lights
+            data.attenuation_constant = light->attenuation_constant;
+            data.attenuation_linear = light->attenuation_linear;
+            data.attenuation_quadratic = light->attenuation_quadratic;
+            // and cone angles are used by spot lights
+            data.inner_angle = light->inner_angle;
+            data.outer_angle = light->outer_angle;
+            lightData.push_back(data);
+        };
+
+        // The ambient term of every light is not attenuated, so it is summed once for all the fragments.
+        // The directional lights come first in the light data since every fragment loops over them.
+        for (const LightComponent *light : lights)
+        {
+            block.ambient += light->ambient;
+            if (light->lightType == LightType::DIRECTIONAL)
+            {
+                pack(light);
+                lightMix.x++;
+            }
+        }
+        block.directionalCount = lightMix.x;
+
+        // Then the point lights are binned before the spot lights, so that each cluster lists its point lights first
+        for (LightType type : {LightType::POINT, LightType::SPOT})
+        {
+            for (const LightComponent *light : lights)
+            {
+                if (light->lightType != type)
+                    continue;
+                (type == LightType::POINT ? lightMix.y : lightMix.z)++;
+                float range = getLightRange(light);
+                if (range <= 0 || lightData.size() > MAX_CLUSTERED_LIGHTS)
+                {
+                    stats.culledLights++;
+                    continue;
+                }
+                // A point light is bounded by a sphere around it. A narrow spot light is bounded by the smallest sphere around its cone
+                // (its center is along the cone axis and the apex & the rim of the cone are on the sphere).
+                glm::vec3 center = light->getOwner()->localTransform.position;
+                float radius = range;
+                float cosine = std::cos(std::clamp(light->outer_angle, 0.0f, glm::pi<float>()));
+                if (type == LightType::SPOT && std::isfinite(range) && cosine > 0.5f)
+                {
+                    radius = range / (2 * cosine);
+                    center += glm::normalize(light->getOwner()->localTransform.rotation) * radius;
+                }
+                size_t binnedBefore = binned.size();
+                binSphere((uint16_t)lightData.size(), glm::vec3(view * glm::vec4(center, 1.0f)), radius, projection, near, far, viewportSize);
+                if (binned.size() == binnedBefore)
+                    stats.culledLights++;
+                else
+                    pack(light);
+            }
+        }
+
+        // The (cluster, light) pairs are counting sorted by cluster. The sort is stable so the point lights stay before the spot lights.
+        clusterRanges.assign(clusterCount, glm::uvec2(0));
+        for (auto [cluster, light] : binned)
+            clusterRanges[cluster].y += lightData[light].type == (GLfloat)LightType::SPOT ? 0x10000u : 1u;
+        uint32_t offset = 0;
+        for (glm::uvec2 &range : clusterRanges)
+        {
+            range.x = offset;
+            uint32_t count = (range.y & 0xFFFF) + (range.y >> 16);
+            stats.maxClusterLights = std::max(stats.maxClusterLights, count);
+            offset += count;
+        }
+        stats.lightIndices = offset;
+        lightIndices.resize(offset);
+        clusterCounts.assign(clusterCount, 0);
+        for (auto [cluster, light] : binned)
+            lightIndices[clusterRanges[cluster].x + clusterCounts[cluster]++] = light;
+
+        uploadBuffer(dataBuffer, lightData.data(), lightData.size() * sizeof(LightData));
+        uploadBuffer(rangeBuffer, clusterRanges.data(), clusterRanges.size() * sizeof(glm::uvec2));
+        uploadBuffer(indexBuffer, lightIndices.data(), lightIndices.size() * sizeof(uint16_t));
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        // The view depth is minus the view space z, so it is read from the third row of the view matrix
+        block.viewDepth = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+        block.gridSize = glm::ivec4(gridSize, 0);
+        block.clusterParams = glm::vec4(tileSize, logScale, logBias);
+        glBindBuffer(GL_UNIFORM_BUFFER, blockBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void LightClusters::bind() const
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BINDING, blockBuffer);
+        std::pair<GLuint, GLuint> textures[] = {{LIGHT_DATA_UNIT, dataTexture}, {CLUSTER_RANGES_UNIT, rangeTexture}, {LIGHT_INDICES_UNIT, indexTexture}};
+        for (auto [unit, texture] : textures)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+        }
+        // The materials expect the first unit to be active
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void LightClusters::setupShader(ShaderProgram *shader)
+    {
+        // Lit shaders read the lights from the "Lights" block & the light buffer textures, so we connect them to their binding points
+        if (!shader->bindUniformBlock("Lights", LIGHTS_BINDING))
+            return;
+        shader->set("light_data", (GLint)LIGHT_DATA_UNIT);
+        shader->set("cluster_ranges", (GLint)CLUSTER_RANGES_UNIT);
+        shader->set("light_indices", (GLint)LIGHT_INDICES_UNIT);
+    }
+
+}
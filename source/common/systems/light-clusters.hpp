@@ -0,0 +1,123 @@
+#pragma once
+
+#include "../components/light.hpp"
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // The uniform buffer binding point to which the "Lights" uniform block of the lit shaders is bound
+    constexpr GLuint LIGHTS_BINDING = 0;
+    // The texture units from which the lit shaders read the light buffer textures (above the units used by the materials)
+    constexpr GLuint LIGHT_DATA_UNIT = 13, CLUSTER_RANGES_UNIT = 14, LIGHT_INDICES_UNIT = 15;
+
+    // The data of a single light as it is laid out in the light data buffer texture (6 RGBA32F texels per light).
+    // It must match "fetch_light" in "assets/shaders/common/lights.glsl".
+    struct LightData {
+        glm::vec3 diffuse;
+        GLfloat type; // Stored as a float since the buffer texture only holds floats
+        glm::vec3 specular;
+        GLfloat attenuation_constant;
+        glm::vec3 ambient;
+        GLfloat attenuation_linear;
+        glm::vec3 position;
+        GLfloat attenuation_quadratic;
+        glm::vec3 direction;
+        GLfloat inner_angle;
+        GLfloat outer_angle;
+        GLfloat padding[3];
+    };
+    static_assert(sizeof(LightData) == 6 * sizeof(glm::vec4), "LightData must be made of 6 texels");
+
+    // The content of the "Lights" uniform block (std140) which is uploaded once per frame
+    struct LightBlock {
+        glm::vec4 viewDepth;       // The view depth of a world position is dot(viewDepth, vec4(position, 1))
+        glm::vec3 ambient;         // The sum of the ambient colors of all the lights (the ambient term is not attenuated)
+        GLint directionalCount;    // The directional lights are the first lights of the light data and they light every fragment
+        glm::ivec4 gridSize;       // The number of clusters along x, y & z (w is unused)
+        glm::vec4 clusterParams;   // The tile size in pixels (x, y) then the scale & bias that map log(depth) to a slice (z, w)
+    };
+    static_assert(sizeof(LightBlock) == 64, "LightBlock must match the std140 layout of the Lights block");
+
+    // The statistics of the last binning
+    struct LightClusterStats {
+        unsigned int lights = 0;          // All the lights of the frame
+        unsigned int culledLights = 0;    // The point & spot lights that are outside the frustum or too dim to light anything
+        unsigned int lightIndices = 0;    // The total length of the per-cluster light lists
+        unsigned int maxClusterLights = 0; // The longest light list of a single cluster
+    };
+
+    // Clustered light culling: the camera frustum is sliced into a 3D grid of clusters (screen tiles along x & y, and slices along
+    // the view depth whose thickness grows exponentially). Every frame, the bounding sphere of each point & spot light is binned
+    // into the clusters it touches and each cluster gets a compact list of light indices. A fragment finds its cluster from its
+    // screen position & depth, then only evaluates the lights of that list (plus the directional lights which light everything).
+    // The lights, the cluster ranges and the light lists are all uploaded through buffer textures, so the light count is not capped.
+    class LightClusters {
+        // The number of clusters along x, y & z
+        glm::ivec3 gridSize = {16, 9, 24};
+        // A light is binned up to the distance at which its attenuated intensity drops below this fraction of the full intensity
+        float cutoff = 1.0f / 256.0f;
+
+        // The view space bounds of every cluster. They only depend on the projection and are rebuilt when it changes.
+        struct ClusterBounds {
+            glm::vec3 min, max;
+        };
+        std::vector<ClusterBounds> clusterBounds;
+        glm::mat4 boundsProjection = glm::mat4(0.0f);
+        glm::ivec2 boundsViewport = glm::ivec2(0);
+        glm::vec2 tileSize = glm::vec2(1.0f); // The size of a cluster on the screen in pixels
+        float logScale = 0.0f, logBias = 0.0f; // Map log(depth) to a slice index
+
+        // The CPU side of the buffers. They are kept between frames to avoid reallocating them.
+        std::vector<LightData> lightData;
+        std::vector<glm::uvec2> clusterRanges; // (first index, point count | spot count << 16) of each cluster
+        std::vector<uint16_t> lightIndices;
+        std::vector<std::pair<uint32_t, uint16_t>> binned; // (cluster, light) pairs in the order they are binned
+        std::vector<uint32_t> clusterCounts;
+        LightBlock block;
+        // The counts of directional, point & spot lights
+        glm::ivec3 lightMix = glm::ivec3(0);
+        LightClusterStats stats;
+
+        // The OpenGL objects (a buffer & a buffer texture for each list, and the uniform buffer of the "Lights" block)
+        GLuint dataBuffer = 0, rangeBuffer = 0, indexBuffer = 0;
+        GLuint dataTexture = 0, rangeTexture = 0, indexTexture = 0;
+        GLuint blockBuffer = 0;
+
+        // Computes the view space bounds of all the clusters for the given projection
+        void buildClusterBounds(const glm::mat4& projection, float near, float far, glm::ivec2 viewportSize);
+        // Adds the light to every cluster touched by the given view space sphere
+        void binSphere(uint16_t light, const glm::vec3& center, float radius, const glm::mat4& projection, float near, float far, glm::ivec2 viewportSize);
+        // Returns the distance beyond which the light is dimmer than the cutoff (infinity if it never gets that dim)
+        float getLightRange(const LightComponent* light) const;
+
+    public:
+        // Creates the buffers and reads the settings from the given json object:
+        //    { "grid": [x, y, z], "cutoff": fraction }
+        void initialize(const nlohmann::json& config);
+        // Deletes the buffers
+        void destroy();
+
+        // Packs the lights, bins the point & spot lights into the clusters of the given camera then uploads everything
+        void update(const std::vector<LightComponent*>& lights, const glm::mat4& view, const glm::mat4& projection,
+                    float near, float far, glm::ivec2 viewportSize);
+        // Binds the uniform block and the buffer textures to the binding points read by the lit shaders
+        void bind() const;
+
+        // Connects the "Lights" block and the light samplers of the given shader to their binding points.
+        // The shader must be the one in use since the sampler units are sent as uniforms.
+        static void setupShader(ShaderProgram* shader);
+
+        // Returns the number of directional, point & spot lights of the last update
+        glm::ivec3 getLightMix() const { return lightMix; }
+        // Returns the statistics of the last update
+        const LightClusterStats& getStats() const { return stats; }
+    };
+
+}
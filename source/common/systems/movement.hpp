@@ -2,6 +2,8 @@
 
 #include "../ecs/world.hpp"
 #include "../components/movement.hpp"
+#include "../components/free-camera-controller.hpp"
+#include "../profiler.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
@@ -15,53 +17,48 @@ namespace our
     // This system is added as a simple example for how use the ECS framework to implement logic. 
     // For more information, see "common/components/movement.hpp"
     class MovementSystem {
+        // The interned names of the entities that the system looks for
+        const NameId playerName = internName("player"), monsterName = internName("monster"), skullName = internName("skull");
     public:
 
         // This should be called every frame to update all entities containing a MovementComponent. 
         void update(World* world, float deltaTime) {
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                // Get the movement component if it exists
-                MovementComponent* movement = entity->getComponent<MovementComponent>();
+            PROFILE_SCOPE("MovementSystem");
+            // Player Position
+            // The player is found in O(1) using the world's name index
+            glm::vec3 playerPos = {0, 0, 10};
+            if (Entity* player = world->findByName(playerName))
+            {
+                playerPos = player->localTransform.position;
+            }
 
-                // Player Position
-                glm::vec3 playerPos = {0, 0, 10};
+            // For each entity that has a movement component
+            for(auto [movement] : world->view<MovementComponent>()){
+                Entity* entity = movement->getOwner();
 
-                for (auto entity : world->getEntities())
+                // Move Monsters in the direction of the player
+                if (entity->getNameId() == monsterName)
                 {
-                    if (entity->name == "player")
-                    {
-                        playerPos = entity->localTransform.position;
-                    }
+                    // Get the direction from the zombie to the player
+                    auto direction = (playerPos - entity->localTransform.position);
+                    // Normalize the direction
+                    direction = normalize(direction);
+                    // Move the zombie in the direction of the player
+                    entity->localTransform.position += deltaTime * direction * 3.0f;
+                    // Rotate the zombie to look at the player
+                    auto angle = atan2(direction.x, direction.z);
+                    entity->localTransform.rotation = glm::vec3(0, angle, 0);
                 }
-
-                // Move Monsters in the direction of the player
-                if (movement)
+                if (entity->getNameId() == skullName)
                 {
-                    if (entity->name == "monster")
-                    {
-                        // Get the direction from the zombie to the player
-                        auto direction = (playerPos - entity->localTransform.position);
-                        // Normalize the direction
-                        direction = normalize(direction);
-                        // Move the zombie in the direction of the player
-                        entity->localTransform.position += deltaTime * direction * 3.0f;
-                        // Rotate the zombie to look at the player
-                        auto angle = atan2(direction.x, direction.z);
-                        entity->localTransform.rotation = glm::vec3(0, angle, 0);
-                    }
-                    if (entity->name == "skull")
-                    {
-                        // Get the direction from the zombie to the player
-                        auto direction = (playerPos - entity->localTransform.position);
-                        // Normalize the direction
-                        direction = normalize(direction);
-                        // Rotate the zombie to look at the player
-                        auto angle = atan2(direction.x, direction.z);
-                        entity->localTransform.rotation = glm::vec3(-90, angle, 0);
-                    }
+                    // Get the direction from the zombie to the player
+                    auto direction = (playerPos - entity->localTransform.position);
+                    // Normalize the direction
+                    direction = normalize(direction);
+                    // Rotate the zombie to look at the player
+                    auto angle = atan2(direction.x, direction.z);
+                    entity->localTransform.rotation = glm::vec3(-90, angle, 0);
                 }
-
             }
         }
 
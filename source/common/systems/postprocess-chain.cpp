@@ -0,0 +1,271 @@
+#include "postprocess-chain.hpp"
+#include "../texture/texture2d.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+
+namespace our
+{
+
+    namespace
+    {
+        // The bytes per pixel of the color textures read & written by the passes (they are RGBA8)
+        constexpr uint64_t BYTES_PER_PIXEL = 4;
+
+        bool isWordCharacter(char c)
+        {
+            return std::isalnum((unsigned char)c) || c == '_';
+        }
+
+        // Returns the first word (made of letters, digits & underscores) after the given position
+        std::string nextWord(const std::string &source, size_t position)
+        {
+            while (position < source.size() && !isWordCharacter(source[position]))
+                position++;
+            size_t end = position;
+            while (end < source.size() && isWordCharacter(source[end]))
+                end++;
+            return source.substr(position, end - position);
+        }
+    }
+
+    bool PostprocessChain::parseEffect(const nlohmann::json &entry, PostprocessEffect &effect)
+    {
+        if (entry.is_object())
+        {
+            effect.name = entry.value<std::string>("effect", "");
+            effect.halfResolution = entry.value("halfResolution", false);
+        }
+        else
+        {
+            effect.name = entry.get<std::string>();
+        }
+
+        // A path to a fragment shader is drawn as it is in its own pass
+        if (std::filesystem::path(effect.name).extension() == ".frag")
+        {
+            effect.kind = PostprocessEffect::Kind::SHADER;
+            effect.path = effect.name;
+            return true;
+        }
+
+        effect.path = std::string(POSTPROCESS_EFFECTS_DIRECTORY) + "/" + effect.name + ".glsl";
+        effect.function = effect.name;
+        std::replace(effect.function.begin(), effect.function.end(), '-', '_');
+        std::ifstream file(effect.path);
+        if (!file)
+        {
+            std::cerr << "ERROR: Couldn't find the postprocess effect \"" << effect.name << "\" (expected: " << effect.path << ")" << std::endl;
+            return false;
+        }
+        std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // The kind of the effect is found from the type of the first parameter of its function
+        for (size_t position = source.find(effect.function); position != std::string::npos; position = source.find(effect.function, position + 1))
+        {
+            size_t open = position + effect.function.size();
+            // The name must be a whole word followed by the parameters
+            bool wholeWord = position == 0 || !isWordCharacter(source[position - 1]);
+            if (!wholeWord || source.compare(open, 1, "(") != 0)
+                continue;
+            std::string parameterType = nextWord(source, open + 1);
+            if (parameterType == "vec4")
+                effect.kind = PostprocessEffect::Kind::PER_PIXEL;
+            else if (parameterType == "sampler2D")
+                effect.kind = PostprocessEffect::Kind::NEIGHBOURHOOD;
+            else
+                continue;
+            return true;
+        }
+        std::cerr << "ERROR: The postprocess effect \"" << effect.path << "\" doesn't define \"vec4 " << effect.function
+                  << "(vec4 color, vec2 uv)\" or \"vec4 " << effect.function << "(sampler2D source, vec2 uv)\"" << std::endl;
+        return false;
+    }
+
+    ShaderProgram *PostprocessChain::createPassShader(size_t first, size_t last, const std::string &description) const
+    {
+        ShaderProgram *shader = new ShaderProgram();
+        bool attached = shader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        if (first < last && effects[first].kind == PostprocessEffect::Kind::SHADER)
+        {
+            attached = shader->attach(effects[first].path, GL_FRAGMENT_SHADER) && attached;
+        }
+        else
+        {
+            // The effects are included then their functions are called in order on the color of the pixel
+            // (A neighbourhood effect can only be the first one, so it is the one that reads the input)
+            std::ostringstream source, body;
+            source << "#version 330\n"
+                   << "uniform sampler2D tex;\n"
+                   << "in vec2 tex_coord;\n"
+                   << "out vec4 frag_color;\n";
+            if (first < last && effects[first].kind == PostprocessEffect::Kind::NEIGHBOURHOOD)
+                body << "    vec4 color = " << effects[first].function << "(tex, tex_coord);\n";
+            else
+                body << "    vec4 color = texture(tex, tex_coord);\n";
+            for (size_t index = first; index < last; index++)
+            {
+                source << "#include \"" << effects[index].name << ".glsl\"\n";
+                if (effects[index].kind == PostprocessEffect::Kind::PER_PIXEL)
+                    body << "    color = " << effects[index].function << "(color, tex_coord);\n";
+            }
+            source << "void main(){\n"
+                   << body.str()
+                   << "    frag_color = color;\n"
+                   << "}\n";
+            // The generated shader is named as if it was a file in the effects directory so that the includes are found there
+            std::string name = std::string(POSTPROCESS_EFFECTS_DIRECTORY) + "/generated(" + description + ").frag";
+            attached = shader->attachSource(source.str(), GL_FRAGMENT_SHADER, name) && attached;
+        }
+        if (!attached || !shader->link())
+        {
+            delete shader;
+            return nullptr;
+        }
+        // The input is always read from the texture unit 0
+        shader->use();
+        shader->set("tex", 0);
+        return shader;
+    }
+
+    void PostprocessChain::initialize(const nlohmann::json &config)
+    {
+        effects.clear();
+        passes.clear();
+        nlohmann::json entries = config.is_array() ? config : config.is_null() ? nlohmann::json::array() : nlohmann::json::array({config});
+        for (const auto &entry : entries)
+        {
+            PostprocessEffect effect;
+            if (parseEffect(entry, effect))
+                effects.push_back(std::move(effect));
+        }
+
+        // The chain is split into the ranges of effects that are fused into the same pass. A pass starts at the start of the chain,
+        // at every neighbourhood effect and at every shader, then it takes all the per-pixel effects that follow
+        // (except a shader which is drawn alone since the other effects can't be added to its "main")
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t index = 0; index < effects.size();)
+        {
+            size_t first = index++;
+            if (effects[first].kind != PostprocessEffect::Kind::SHADER)
+                while (index < effects.size() && effects[index].kind == PostprocessEffect::Kind::PER_PIXEL)
+                    index++;
+            ranges.emplace_back(first, index);
+        }
+        // Without effects, the scene is only copied (and upscaled) to the window
+        if (ranges.empty())
+            ranges.emplace_back(0, 0);
+
+        for (auto [first, last] : ranges)
+        {
+            Pass pass;
+            pass.description = first == last ? "copy" : "";
+            pass.halfResolution = false;
+            for (size_t index = first; index < last; index++)
+            {
+                pass.description += (index > first ? " + " : "") + effects[index].name;
+                pass.halfResolution = pass.halfResolution || effects[index].halfResolution;
+            }
+            pass.shader = createPassShader(first, last, pass.description);
+            if (pass.shader)
+                passes.push_back(pass);
+            else
+                std::cerr << "ERROR: Couldn't create the postprocess pass \"" << pass.description << "\", so it is skipped" << std::endl;
+        }
+        // If no pass could be created, the scene is still copied (and upscaled) to the window instead of leaving it black
+        if (passes.empty() && !ranges.empty() && ranges.front().first != ranges.front().second)
+        {
+            Pass pass{createPassShader(0, 0, "copy"), "copy", false};
+            if (pass.shader)
+                passes.push_back(pass);
+            else
+                std::cerr << "ERROR: Couldn't create the postprocess copy pass, so the scene can't be drawn to the window" << std::endl;
+        }
+        // The last pass is drawn to the window, so it is always at the window resolution
+        if (!passes.empty() && passes.back().halfResolution)
+        {
+            std::cerr << "WARNING: The last postprocess pass \"" << passes.back().description << "\" is drawn to the window, so it can't be at half resolution" << std::endl;
+            passes.back().halfResolution = false;
+        }
+        std::cout << "Postprocess chain: " << effects.size() << " effect(s) in " << passes.size() << " pass(es)";
+        for (const Pass &pass : passes)
+            std::cout << " [" << pass.description << (pass.halfResolution ? " (half resolution)" : "") << "]";
+        std::cout << std::endl;
+
+        // The vertex array is empty since the fullscreen triangle is generated by the vertex shader
+        glGenVertexArrays(1, &vertexArray);
+
+        // The input of each pass is sampled linearly so that it is upscaled smoothly when its resolution is lower than the output
+        sampler = new Sampler();
+        sampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        sampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // The default options are fine but we don't need to interact with the depth buffer
+        // so it is more performant to disable the depth mask
+        pipelineState.depthMask = false;
+    }
+
+    void PostprocessChain::destroy()
+    {
+        for (Pass &pass : passes)
+            delete pass.shader;
+        passes.clear();
+        effects.clear();
+        delete sampler;
+        sampler = nullptr;
+        glDeleteVertexArrays(1, &vertexArray);
+        vertexArray = 0;
+    }
+
+    void PostprocessChain::apply(Texture2D *source, glm::ivec2 sourceSize, glm::ivec2 windowSize, RenderTargetPool &pool)
+    {
+        stats = PostprocessStats();
+        if (passes.empty())
+            return;
+        pipelineState.setup();
+        glBindVertexArray(vertexArray);
+        glActiveTexture(GL_TEXTURE0);
+        sampler->bind(0);
+
+        Texture2D *input = source;
+        glm::ivec2 inputSize = sourceSize;
+        RenderTarget *inputTarget = nullptr; // The target holding the input (null if the input is the source)
+        for (size_t index = 0; index < passes.size(); index++)
+        {
+            const Pass &pass = passes[index];
+            // The intermediate passes keep the resolution of the scene (or half of it) and only the last one outputs to the window
+            RenderTarget *outputTarget = nullptr;
+            glm::ivec2 outputSize = windowSize;
+            if (index + 1 < passes.size())
+            {
+                outputSize = pass.halfResolution ? glm::max(glm::ivec2(1), sourceSize / 2) : sourceSize;
+                outputTarget = pool.acquire(outputSize, false);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, outputTarget ? outputTarget->framebuffer : 0);
+            glViewport(0, 0, outputSize.x, outputSize.y);
+
+            pass.shader->use();
+            input->bind();
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            stats.passes++;
+            stats.bytesRead += (uint64_t)inputSize.x * inputSize.y * BYTES_PER_PIXEL;
+            stats.bytesWritten += (uint64_t)outputSize.x * outputSize.y * BYTES_PER_PIXEL;
+
+            // The input of this pass is free again, so the output of the next pass may reuse it (the targets are used in turns)
+            if (inputTarget)
+                pool.release(inputTarget);
+            inputTarget = outputTarget;
+            input = outputTarget ? outputTarget->color : nullptr;
+            inputSize = outputSize;
+        }
+        glBindVertexArray(0);
+    }
+
+}
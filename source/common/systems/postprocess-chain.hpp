@@ -0,0 +1,100 @@
+#pragma once
+
+#include "dynamic-resolution.hpp"
+#include "../shader/shader.hpp"
+#include "../texture/sampler.hpp"
+#include "../material/pipeline-state.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // The directory of the effects that can be named in the postprocess chain.
+    // Each effect is a file "<name>.glsl" defining a single function named after the effect (with "-" replaced by "_"):
+    // - A per-pixel effect only depends on the color of its pixel: "vec4 name(vec4 color, vec2 uv)".
+    // - A neighbourhood effect samples the pixels around its pixel: "vec4 name(sampler2D source, vec2 uv)".
+    // The files must only declare names prefixed by the effect name so that any effects can be included in the same shader.
+    constexpr const char *POSTPROCESS_EFFECTS_DIRECTORY = "assets/shaders/postprocess/effects";
+
+    // An entry of the postprocess chain
+    struct PostprocessEffect
+    {
+        enum class Kind
+        {
+            PER_PIXEL,
+            NEIGHBOURHOOD,
+            SHADER // A whole fragment shader given by its path (e.g. "assets/shaders/postprocess/vignette.frag")
+        };
+        Kind kind;
+        std::string name;     // The name of the effect (or the path of the shader)
+        std::string function; // The function defined by the effect file
+        std::string path;     // The effect file (or the shader file)
+        // If true, the pass of this effect is drawn into a target of half the scene resolution
+        // (the next pass upscales it while sampling it with the linear sampler)
+        bool halfResolution = false;
+    };
+
+    // The statistics of the last frame drawn by the postprocess chain
+    struct PostprocessStats
+    {
+        unsigned int passes = 0;
+        // The traffic of the passes in bytes. Each pass is counted as reading every texel of its input once and writing every
+        // pixel of its output once (the extra samples of the neighbourhood effects mostly hit the texture cache).
+        uint64_t bytesRead = 0, bytesWritten = 0;
+    };
+
+    // Applies a chain of postprocess effects to the scene using as few fullscreen passes as possible.
+    // Every pass writes each of its pixels to memory then the next pass reads them back, so the chain is split into passes
+    // only where it is needed: a neighbourhood effect must read the finished output of the effects before it, so it starts
+    // a new pass, while the per-pixel effects that follow it are fused into the same pass by generating a shader that calls
+    // all their functions in order on the color of the pixel. So "radial-blur, grayscale, vignette" is drawn in a single pass,
+    // while "grayscale, radial-blur, vignette" needs two. The intermediate passes are drawn into render targets taken from
+    // the pool (so two targets are used in turns) and the last pass is drawn to the window, which also upscales the scene.
+    class PostprocessChain
+    {
+        // A fullscreen pass and the effects that were fused into it
+        struct Pass
+        {
+            ShaderProgram *shader;
+            std::string description;
+            bool halfResolution;
+        };
+        std::vector<PostprocessEffect> effects;
+        std::vector<Pass> passes;
+        Sampler *sampler = nullptr;
+        GLuint vertexArray = 0;
+        PipelineState pipelineState;
+        PostprocessStats stats;
+
+        // Reads an entry of the chain (returns false if the effect could not be found)
+        static bool parseEffect(const nlohmann::json &entry, PostprocessEffect &effect);
+        // Creates the shader of a pass that applies the effects [first, last) to its input (returns nullptr if it failed)
+        ShaderProgram *createPassShader(size_t first, size_t last, const std::string &description) const;
+
+    public:
+        // Reads the chain from the "postprocess" value of the renderer config and creates the shaders of its passes.
+        // The value is either the path of a single fragment shader (as before the chain existed) or an array of entries where
+        // each entry is the name of an effect, the path of a fragment shader, or { "effect": name, "halfResolution": true }.
+        // An empty chain (or a null value) draws a single pass that copies the scene to the window, and so does a chain
+        // whose passes all failed to compile.
+        void initialize(const nlohmann::json &config);
+        // Deletes the shaders and the other objects of the chain
+        void destroy();
+
+        // Draws the passes. The first one reads the source texture (whose size is "sourceSize") and the last one is drawn to
+        // the default framebuffer covering "windowSize". The intermediate targets are acquired from & released to the pool.
+        void apply(Texture2D *source, glm::ivec2 sourceSize, glm::ivec2 windowSize, RenderTargetPool &pool);
+
+        // Returns the number of passes drawn every frame
+        size_t getPassCount() const { return passes.size(); }
+        // Returns the statistics of the last frame
+        const PostprocessStats &getStats() const { return stats; }
+    };
+
+}
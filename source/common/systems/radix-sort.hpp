@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+namespace our
+{
+
+    // Sorts "indices" by their 32-bit "keys" in ascending order using a least significant digit radix sort (4 passes of 8 bits).
+    // Equal keys keep their relative order. The keys are reordered alongside the indices.
+    // The scratch vectors are used as the second buffer of each pass, so keeping them between calls avoids reallocating them.
+    // The cost is linear in the number of keys and a pass is skipped if all the keys have the same value in its byte.
+    inline void radixSort(std::vector<uint32_t> &keys, std::vector<uint32_t> &indices,
+                          std::vector<uint32_t> &keyScratch, std::vector<uint32_t> &indexScratch)
+    {
+        const size_t count = keys.size();
+        keyScratch.resize(count);
+        indexScratch.resize(count);
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            // Count the keys having each value of the current byte
+            size_t offsets[256] = {};
+            for (uint32_t key : keys)
+                offsets[(key >> shift) & 0xFF]++;
+            // If all the keys share the same byte, this pass would not change the order
+            if (offsets[(keys.empty() ? 0 : keys[0] >> shift) & 0xFF] == count)
+                continue;
+            // Turn the counts into the position of the first key having each byte value
+            size_t position = 0;
+            for (size_t &offset : offsets)
+            {
+                size_t bucketSize = offset;
+                offset = position;
+                position += bucketSize;
+            }
+            // Scatter the keys and the indices into the scratch buffers then swap the buffers
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t destination = offsets[(keys[i] >> shift) & 0xFF]++;
+                keyScratch[destination] = keys[i];
+                indexScratch[destination] = indices[i];
+            }
+            std::swap(keys, keyScratch);
+            std::swap(indices, indexScratch);
+        }
+    }
+
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../components/collider.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace our
+{
+
+    // A uniform grid stored in a hash map that is used as the broadphase of the collision detection.
+    // Each collider is registered in every cell that its bounding sphere overlaps, so two colliders can only
+    // be in contact if they share at least one cell. The grid is updated incrementally: a collider is only
+    // moved between cells when the range of cells it overlaps changes (see "update").
+    class SpatialHash {
+        float cellSize; // The edge length of a grid cell in world units
+        std::unordered_map<uint64_t, std::vector<Collider*>> cells; // Maps a packed cell coordinate to the colliders overlapping it
+        std::unordered_set<Collider*> colliders; // All the colliders currently registered in this grid
+        unsigned int queryStamp = 0; // Incremented with each query and used to report every candidate only once
+
+        // Packs a cell coordinate into a single 64-bit key (21 bits per axis)
+        static uint64_t key(int x, int y, int z) {
+            const uint64_t mask = (1ull << 21) - 1;
+            return ((uint64_t)x & mask) | (((uint64_t)y & mask) << 21) | (((uint64_t)z & mask) << 42);
+        }
+
+        // Computes the range of cells overlapped by a sphere
+        void cellRange(const glm::vec3& center, float radius, glm::ivec3& min, glm::ivec3& max) const {
+            min = glm::ivec3(glm::floor((center - radius) / cellSize));
+            max = glm::ivec3(glm::floor((center + radius) / cellSize));
+        }
+
+        // Adds or removes the collider to/from every cell in its current cell range
+        void insertIntoCells(Collider* collider) {
+            for(int x = collider->cellMin.x; x <= collider->cellMax.x; x++)
+                for(int y = collider->cellMin.y; y <= collider->cellMax.y; y++)
+                    for(int z = collider->cellMin.z; z <= collider->cellMax.z; z++)
+                        cells[key(x, y, z)].push_back(collider);
+        }
+        void removeFromCells(Collider* collider) {
+            for(int x = collider->cellMin.x; x <= collider->cellMax.x; x++)
+                for(int y = collider->cellMin.y; y <= collider->cellMax.y; y++)
+                    for(int z = collider->cellMin.z; z <= collider->cellMax.z; z++){
+                        auto it = cells.find(key(x, y, z));
+                        if(it == cells.end()) continue;
+                        auto& cell = it->second;
+                        for(size_t i = 0; i < cell.size(); i++){
+                            if(cell[i] == collider){
+                                // The order inside a cell does not matter so we swap with the last element and pop
+                                cell[i] = cell.back();
+                                cell.pop_back();
+                                break;
+                            }
+                        }
+                        // Empty cells are erased so that the map does not grow as objects move around the world
+                        if(cell.empty()) cells.erase(it);
+                    }
+        }
+
+    public:
+        explicit SpatialHash(float cellSize = 2.0f) : cellSize(cellSize) {}
+
+        // Changes the cell size. Since all the cell ranges become invalid, every collider is removed
+        // and it will be registered again the next time "update" is called for it.
+        void setCellSize(float size) {
+            if(size <= 0.0f || size == cellSize) return;
+            clear();
+            cellSize = size;
+        }
+        float getCellSize() const { return cellSize; }
+
+        // Registers the collider in the grid using its current "center" and "Radius".
+        // If the collider is already registered and still overlaps the same cells, nothing is done.
+        void update(Collider* collider) {
+            glm::ivec3 min, max;
+            cellRange(collider->center, collider->Radius, min, max);
+            if(collider->grid == this){
+                if(min == collider->cellMin && max == collider->cellMax) return;
+                removeFromCells(collider);
+            } else {
+                // A collider can only be registered in one grid at a time
+                if(collider->grid) collider->grid->remove(collider);
+                collider->grid = this;
+                colliders.insert(collider);
+            }
+            collider->cellMin = min;
+            collider->cellMax = max;
+            insertIntoCells(collider);
+        }
+
+        // Removes the collider from the grid (this is called by the collider's destructor)
+        void remove(Collider* collider) {
+            if(collider->grid != this) return;
+            removeFromCells(collider);
+            colliders.erase(collider);
+            collider->grid = nullptr;
+        }
+
+        // Calls "visit" once for every other collider sharing at least one cell with the given collider
+        // The given collider must already be registered in this grid
+        template<typename Visitor>
+        void query(Collider* collider, Visitor&& visit) {
+            ++queryStamp;
+            collider->queryStamp = queryStamp;
+            for(int x = collider->cellMin.x; x <= collider->cellMax.x; x++)
+                for(int y = collider->cellMin.y; y <= collider->cellMax.y; y++)
+                    for(int z = collider->cellMin.z; z <= collider->cellMax.z; z++){
+                        auto it = cells.find(key(x, y, z));
+                        if(it == cells.end()) continue;
+                        for(auto other : it->second){
+                            // Skip the colliders that were already reported by another cell in this query
+                            if(other->queryStamp == queryStamp) continue;
+                            other->queryStamp = queryStamp;
+                            visit(other);
+                        }
+                    }
+        }
+
+        // Returns the number of non-empty cells (useful for debugging)
+        size_t getCellCount() const { return cells.size(); }
+        // Returns the number of registered colliders
+        size_t getColliderCount() const { return colliders.size(); }
+
+        // Unregisters all the colliders
+        void clear() {
+            for(auto collider : colliders) collider->grid = nullptr;
+            colliders.clear();
+            cells.clear();
+        }
+
+        // The colliders must not keep a pointer to a destroyed grid
+        ~SpatialHash() { clear(); }
+
+        SpatialHash(const SpatialHash&) = delete;
+        SpatialHash& operator=(const SpatialHash&) = delete;
+    };
+
+}
@@ -1,13 +1,55 @@
 #include "screenshot.hpp"
+#include "../thread-pool.hpp"
+#include "../profiler.hpp"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb/stb_image_write.h>
 
-#include <glad/gl.h>
-
-#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Saves RGBA pixels read from OpenGL to a png file
+    // Since texture row in OpenGL start from bottom and goes up, we need to flip since image formats start from top to bottom.
+    // The rows are flipped here (instead of using "stbi_flip_vertically_on_write") since the flag is shared by all the threads.
+    bool write_png(const std::string& filename, int width, int height, const uint8_t* rgba, bool include_alpha) {
+        // If alpha is included, we have 4 components (RGBA). Otherwise, we only have 3 (RGB).
+        int components = include_alpha ? 4 : 3;
+        std::vector<uint8_t> data((size_t)components * width * height);
+        for(int y = 0; y < height; y++){
+            const uint8_t* source = rgba + (size_t)(height - 1 - y) * width * 4;
+            uint8_t* destination = data.data() + (size_t)y * width * components;
+            if(include_alpha){
+                std::memcpy(destination, source, (size_t)width * 4);
+            } else {
+                for(int x = 0; x < width; x++){
+                    destination[3 * x + 0] = source[4 * x + 0];
+                    destination[3 * x + 1] = source[4 * x + 1];
+                    destination[3 * x + 2] = source[4 * x + 2];
+                }
+            }
+        }
+
+        // Make sure the directory in which we want to save screenshot exists. If not, create it.
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), ec);
+        if(ec) return false;
+
+        // Save image and return whether it succeeded or not
+        return stbi_write_png(filename.c_str(), width, height, components, data.data(), 0);
+    }
+
+}
+
 bool our::screenshot_png(const std::string& filename, bool include_alpha) {
 
     // Read the current viewport parameters
@@ -16,28 +58,128 @@ bool our::screenshot_png(const std::string& filename, bool include_alpha) {
     } viewport;
     glGetIntegerv(GL_VIEWPORT, (GLint*)&viewport);
 
-    // If alpha is included, we have 4 components (RGBA). Otherwise, we only have 3 (RGB).
-    uint8_t components = include_alpha ? 4 : 3;
-
     // Allocate memory to store image
-    std::vector<uint8_t> data(components * viewport.w * viewport.h);
+    std::vector<uint8_t> data(4 * viewport.w * viewport.h);
 
-    // If alpha is included, each pixel will use 4 bytes so the row would always be divisible by 4.
-    // Otherwise, we can only be sure it is divisible by 1 (because everything is divisible by 1).
-    glPixelStorei(GL_PACK_ALIGNMENT, include_alpha ? 4 : 1);
-    // Pick a format for reading pixels from framebuffer
-    GLenum format = include_alpha ? GL_RGBA : GL_RGB;
-    // Read Pixels from framebuffer
-    glReadPixels(viewport.x, viewport.y, viewport.w, viewport.h, format, GL_UNSIGNED_BYTE, data.data());
+    // Each pixel uses 4 bytes so the row would always be divisible by 4.
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // Read Pixels from framebuffer (RGBA is read even if alpha is not included since it is the format the drivers read fastest)
+    glReadPixels(viewport.x, viewport.y, viewport.w, viewport.h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
 
-    // Since texture row in OpenGL start from bottom and goes up, we need to flip since image formats start from top to bottom.
-    stbi_flip_vertically_on_write(true);
+    return write_png(filename, viewport.w, viewport.h, data.data(), include_alpha);
+}
+
+our::ScreenshotWriter::ScreenshotWriter() = default;
+
+our::ScreenshotWriter::~ScreenshotWriter() = default;
+
+void our::ScreenshotWriter::request(const std::string& filename, bool include_alpha) {
+    PROFILE_SCOPE("Screenshot Request");
+    auto start = Clock::now();
+
+    Slot& slot = slots[next_slot];
+    next_slot = (next_slot + 1) % RING_SIZE;
+    // If the slot is still in flight, we have no choice but to wait for it
+    if(slot.fence) resolve(slot, true);
 
-    // Make sure the directory in which we want to save screenshot exists. If not, create it.
-    std::error_code ec;
-    std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), ec);
-    if(ec) return false;
+    // Read the current viewport parameters
+    struct {
+        int x = 0, y = 0, w = 0, h = 0;
+    } viewport;
+    glGetIntegerv(GL_VIEWPORT, (GLint*)&viewport);
+
+    size_t size = (size_t)viewport.w * viewport.h * 4;
+    if(!slot.buffer) glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    // The storage is only reallocated when the viewport grows
+    if(slot.capacity < size){
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    // Since a pixel pack buffer is bound, the last argument is an offset into the buffer and the call returns without waiting for the GPU
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(viewport.x, viewport.y, viewport.w, viewport.h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    slot.path = filename;
+    slot.include_alpha = include_alpha;
+    slot.width = viewport.w;
+    slot.height = viewport.h;
+    slot.frame_milliseconds = millisecondsSince(start);
+}
+
+bool our::ScreenshotWriter::resolve(Slot& slot, bool wait) {
+    auto start = Clock::now();
+    // A zero timeout only checks whether the fence is signaled
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+    if(status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // Copy the pixels out of the buffer so that it can be unmapped (and reused) right away
+    size_t size = (size_t)slot.width * slot.height * 4;
+    auto pixels = std::make_shared<std::vector<uint8_t>>(size);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void* mapped = status == GL_WAIT_FAILED ? nullptr : glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if(mapped){
+        std::memcpy(pixels->data(), mapped, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    double frame_milliseconds = slot.frame_milliseconds + millisecondsSince(start);
+    if(!mapped){
+        std::cerr << "Failed to read back the screenshot: " << slot.path << std::endl;
+        return true;
+    }
+
+    // The encoding is the slowest part, so it is left to a worker thread
+    if(!worker) worker = std::make_unique<ThreadPool>(1);
+    auto encode = [path = slot.path, width = slot.width, height = slot.height, include_alpha = slot.include_alpha, pixels]{
+        auto start = Clock::now();
+        if(!write_png(path, width, height, pixels->data(), include_alpha)) return -1.0;
+        return millisecondsSince(start);
+    };
+    encodings.push_back({slot.path, frame_milliseconds, worker->submit(encode)});
+    return true;
+}
+
+void our::ScreenshotWriter::report(bool wait) {
+    for(auto it = encodings.begin(); it != encodings.end();){
+        if(!wait && it->encode_milliseconds.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+            ++it;
+            continue;
+        }
+        double encode_milliseconds = it->encode_milliseconds.get();
+        if(encode_milliseconds >= 0){
+            std::cout << "Screenshot saved to: " << it->path << " (" << it->frame_milliseconds << " ms on the frame, "
+                      << encode_milliseconds << " ms encoding on the worker)" << std::endl;
+        } else {
+            std::cerr << "Failed to save a screenshot to: " << it->path << std::endl;
+        }
+        it = encodings.erase(it);
+    }
+}
+
+void our::ScreenshotWriter::update() {
+    PROFILE_SCOPE("Screenshot Readback");
+    // The slots are resolved in the order they were requested
+    for(int i = 0; i < RING_SIZE; i++){
+        Slot& slot = slots[(next_slot + i) % RING_SIZE];
+        if(slot.fence && !resolve(slot, false)) break;
+    }
+    report(false);
+}
 
-    // Save image and return whether it succeeded or not
-    return stbi_write_png(filename.c_str(), viewport.w, viewport.h, components, data.data(), 0);
+void our::ScreenshotWriter::shutdown() {
+    for(int i = 0; i < RING_SIZE; i++){
+        Slot& slot = slots[(next_slot + i) % RING_SIZE];
+        if(slot.fence) resolve(slot, true);
+        if(slot.buffer) glDeleteBuffers(1, &slot.buffer);
+        slot.buffer = 0;
+        slot.capacity = 0;
+    }
+    report(true);
+    worker.reset();
 }
@@ -2,11 +2,76 @@
 #define GFX_LAB_SCREENSHOT_H
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <cstdint>
+
+#include <glad/gl.h>
 
 namespace our {
 
+    class ThreadPool;
+
+    // Reads the current viewport and saves it to a png file. The frame waits for the GPU, the readback and the encoding.
     bool screenshot_png(const std::string& filename, bool include_alpha = false);
 
+    // Captures screenshots without stalling the frame in which they are requested.
+    // The viewport is read into a pixel buffer object (so "request" returns before the GPU is done rendering),
+    // then, once its fence is signaled (usually a frame or two later), "update" copies the pixels out of the buffer
+    // and a worker thread flips, encodes & writes the png file.
+    // The time spent on the main thread and on the worker is printed with each saved screenshot.
+    class ScreenshotWriter {
+        // The number of captures that can be in flight on the GPU at the same time
+        static constexpr int RING_SIZE = 3;
+
+        // A pixel buffer object in the ring and the capture that is being read into it
+        struct Slot {
+            GLuint buffer = 0;
+            size_t capacity = 0;       // The size of the buffer storage in bytes
+            GLsync fence = nullptr;    // Signaled when the pixels are in the buffer (nullptr if the slot is free)
+            std::string path;
+            bool include_alpha = false;
+            int width = 0, height = 0;
+            double frame_milliseconds = 0; // The time spent on the main thread so far
+        };
+
+        // A capture being encoded by the worker
+        struct Encoding {
+            std::string path;
+            double frame_milliseconds;
+            std::future<double> encode_milliseconds; // A negative value means that the file could not be written
+        };
+
+        Slot slots[RING_SIZE];
+        int next_slot = 0;
+        std::vector<Encoding> encodings;
+        std::unique_ptr<ThreadPool> worker;
+
+        // Copies the pixels out of the slot's buffer and sends them to the worker (waits for the GPU if "wait" is true)
+        // Returns false if the pixels are not ready yet
+        bool resolve(Slot& slot, bool wait);
+        // Prints the results of the finished encodings (waits for all of them if "wait" is true)
+        void report(bool wait);
+
+    public:
+        ScreenshotWriter();
+        ~ScreenshotWriter();
+
+        // Starts capturing the current viewport of the bound framebuffer into the given png file
+        // If the ring is full, the oldest capture is resolved first (which may wait for the GPU)
+        void request(const std::string& filename, bool include_alpha = false);
+
+        // Resolves the captures whose pixels are ready and reports the written files. It should be called once per frame.
+        void update();
+
+        // Waits for all the captures to be written then deletes the buffers (must be called while the OpenGL context exists)
+        void shutdown();
+
+        ScreenshotWriter(const ScreenshotWriter&) = delete;
+        ScreenshotWriter& operator=(const ScreenshotWriter&) = delete;
+    };
+
 }
 
 #endif //GFX_LAB_SCREENSHOT_H
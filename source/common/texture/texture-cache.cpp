@@ -0,0 +1,241 @@
+#include "texture-cache.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace our::texture_cache {
+
+    static_assert(sizeof(TextureCacheHeader) == 40, "The texture cache header must have the same layout on all platforms");
+
+    namespace {
+
+        // Returns the size of the given level of an image whose largest level has the given size
+        glm::ivec2 getLevelSize(glm::ivec2 size, uint32_t level) {
+            return glm::max(glm::ivec2(1), glm::ivec2(size.x >> level, size.y >> level));
+        }
+
+        // Returns the size in bytes of all the levels described by the header
+        size_t getContentSize(const TextureCacheHeader& header) {
+            size_t size = 0;
+            for(uint32_t level = 0; level < header.levelCount; level++){
+                glm::ivec2 levelSize = getLevelSize({header.width, header.height}, level);
+                size += (size_t)levelSize.x * levelSize.y * 4;
+            }
+            return size;
+        }
+
+        // Checks that the header belongs to a valid cache file of the given size
+        bool isValidHeader(const TextureCacheHeader& header, size_t fileSize) {
+            if(std::memcmp(header.magic, "TEXC", 4) != 0) return false;
+            if(header.version != TEXTURE_CACHE_VERSION || header.format != (uint32_t)TextureCacheFormat::RGBA8) return false;
+            if(header.colorSpace > (uint32_t)texture_utils::ColorSpace::SRGB) return false;
+            if(header.width == 0 || header.height == 0 || header.levelCount == 0) return false;
+            if(header.levelCount > getLevelCount({header.width, header.height})) return false;
+            return fileSize == sizeof(TextureCacheHeader) + getContentSize(header);
+        }
+
+        // The cache can be used if it is newer than the source image and was built from a source of the same size
+        // If the source is not shipped (e.g. only the baked textures are distributed), we trust the cache
+        bool isFresh(const TextureCacheHeader& header, const std::string& sourcePath, const std::string& cachePath) {
+            std::error_code error;
+            auto sourceSize = std::filesystem::file_size(sourcePath, error);
+            if(error) return true;
+            if(sourceSize != header.sourceSize) return false;
+            auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+            if(error) return true;
+            auto cacheTime = std::filesystem::last_write_time(cachePath, error);
+            return !error && cacheTime >= sourceTime;
+        }
+
+        // The sRGB images are stored with the gamma transfer function, so they are filtered after converting them to linear values
+        // (Averaging the stored values directly darkens the smaller levels, especially around high contrast edges)
+        struct GammaTables {
+            float toLinear[256];
+            GammaTables() {
+                for(int i = 0; i < 256; i++) toLinear[i] = std::pow(i / 255.0f, 2.2f);
+            }
+        };
+
+        unsigned char toGamma(float value) {
+            return (unsigned char)std::clamp(std::pow(value, 1.0f / 2.2f) * 255.0f + 0.5f, 0.0f, 255.0f);
+        }
+
+        // A source pixel and its contribution to a destination pixel along one axis
+        struct Tap {
+            int index;
+            float weight;
+        };
+
+        // Computes, for every destination pixel, the source pixels it covers and how much each of them is covered.
+        // So the filter is a box whose width is the scaling factor, which stays correct for odd sizes (e.g. 5 -> 2 pixels).
+        std::vector<std::vector<Tap>> computeTaps(int sourceSize, int destinationSize) {
+            std::vector<std::vector<Tap>> taps(destinationSize);
+            float scale = (float)sourceSize / destinationSize;
+            for(int d = 0; d < destinationSize; d++){
+                float begin = d * scale, end = (d + 1) * scale;
+                for(int s = (int)std::floor(begin); s < std::min(sourceSize, (int)std::ceil(end)); s++){
+                    float weight = std::min(end, s + 1.0f) - std::max(begin, (float)s);
+                    if(weight > 0) taps[d].push_back({s, weight / scale});
+                }
+            }
+            return taps;
+        }
+
+        // Downsamples an image (of premultiplied linear colors for an sRGB image, or of the stored values for a linear image)
+        std::vector<glm::vec4> downsample(const std::vector<glm::vec4>& source, glm::ivec2 sourceSize, glm::ivec2 destinationSize) {
+            auto tapsX = computeTaps(sourceSize.x, destinationSize.x);
+            auto tapsY = computeTaps(sourceSize.y, destinationSize.y);
+            std::vector<glm::vec4> destination((size_t)destinationSize.x * destinationSize.y);
+            for(int y = 0; y < destinationSize.y; y++){
+                for(int x = 0; x < destinationSize.x; x++){
+                    glm::vec4 sum(0.0f);
+                    for(const Tap& tapY : tapsY[y])
+                        for(const Tap& tapX : tapsX[x])
+                            sum += source[(size_t)tapY.index * sourceSize.x + tapX.index] * (tapX.weight * tapY.weight);
+                    destination[(size_t)y * destinationSize.x + x] = sum;
+                }
+            }
+            return destination;
+        }
+
+        unsigned char toByte(float value) {
+            return (unsigned char)std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f);
+        }
+
+        // Converts the pixels of an image to the values that are filtered
+        std::vector<glm::vec4> decode(const unsigned char* pixels, size_t pixelCount, texture_utils::ColorSpace colorSpace) {
+            static const GammaTables gamma;
+            std::vector<glm::vec4> colors(pixelCount);
+            for(size_t i = 0; i < pixelCount; i++){
+                const unsigned char* pixel = pixels + 4 * i;
+                float alpha = pixel[3] / 255.0f;
+                if(colorSpace == texture_utils::ColorSpace::SRGB)
+                    colors[i] = glm::vec4(gamma.toLinear[pixel[0]] * alpha, gamma.toLinear[pixel[1]] * alpha, gamma.toLinear[pixel[2]] * alpha, alpha);
+                else
+                    colors[i] = glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]) / 255.0f;
+            }
+            return colors;
+        }
+
+        // Converts the filtered values back to stored RGBA8 pixels
+        void encode(const std::vector<glm::vec4>& colors, std::vector<unsigned char>& pixels, texture_utils::ColorSpace colorSpace) {
+            pixels.resize(colors.size() * 4);
+            for(size_t i = 0; i < colors.size(); i++){
+                const glm::vec4& color = colors[i];
+                if(colorSpace == texture_utils::ColorSpace::LINEAR){
+                    for(int channel = 0; channel < 4; channel++) pixels[4 * i + channel] = toByte(color[channel]);
+                    continue;
+                }
+                glm::vec3 rgb = color.a > 0 ? glm::vec3(color) / color.a : glm::vec3(0.0f);
+                pixels[4 * i + 0] = toGamma(rgb.r);
+                pixels[4 * i + 1] = toGamma(rgb.g);
+                pixels[4 * i + 2] = toGamma(rgb.b);
+                pixels[4 * i + 3] = toByte(color.a);
+            }
+        }
+
+    }
+
+    std::string getCachePath(const std::string& sourcePath) {
+        return sourcePath + ".tex";
+    }
+
+    uint32_t getLevelCount(glm::ivec2 size) {
+        uint32_t levels = 1;
+        while(size.x > 1 || size.y > 1){
+            size = glm::max(glm::ivec2(1), size / 2);
+            levels++;
+        }
+        return levels;
+    }
+
+    bool map(const std::string& sourcePath, texture_utils::ImageData& image, texture_utils::ColorSpace colorSpace) {
+        std::string cachePath = getCachePath(sourcePath);
+        auto file = std::make_unique<MappedFile>(cachePath);
+        if(!file->isOpen() || file->size() < sizeof(TextureCacheHeader)) return false;
+        TextureCacheHeader header;
+        std::memcpy(&header, file->data(), sizeof(TextureCacheHeader));
+        if(!isValidHeader(header, file->size()) || !isFresh(header, sourcePath, cachePath)) return false;
+        if(header.colorSpace != (uint32_t)colorSpace) return false;
+
+        // The levels will be sent to the GPU directly from the mapped file
+        image.size = {header.width, header.height};
+        image.levels.clear();
+        const unsigned char* content = file->data() + sizeof(TextureCacheHeader);
+        for(uint32_t level = 0; level < header.levelCount; level++){
+            glm::ivec2 size = getLevelSize(image.size, level);
+            image.levels.push_back({size, content});
+            content += (size_t)size.x * size.y * 4;
+        }
+        image.file = std::move(file);
+        return true;
+    }
+
+    bool write(const std::string& sourcePath, const texture_utils::ImageData& image, texture_utils::ColorSpace colorSpace) {
+        std::error_code error;
+        auto sourceSize = std::filesystem::file_size(sourcePath, error);
+        if(error || !image.isLoaded()) return false;
+
+        TextureCacheHeader header = {};
+        std::memcpy(header.magic, "TEXC", 4);
+        header.version = TEXTURE_CACHE_VERSION;
+        header.format = (uint32_t)TextureCacheFormat::RGBA8;
+        header.colorSpace = (uint32_t)colorSpace;
+        header.width = image.size.x;
+        header.height = image.size.y;
+        header.levelCount = getLevelCount(image.size);
+        header.sourceSize = sourceSize;
+
+        // We write to a temporary file then rename it so that a crash never leaves a half written cache behind
+        std::string cachePath = getCachePath(sourcePath);
+        std::string temporaryPath = cachePath + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!file) return false;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(TextureCacheHeader));
+
+            // The first level is the image itself
+            const unsigned char* base = image.levels[0].pixels;
+            glm::ivec2 size = image.size;
+            size_t pixelCount = (size_t)size.x * size.y;
+            file.write(reinterpret_cast<const char*>(base), pixelCount * 4);
+
+            // Every other level is filtered from the previous one. The intermediate levels are kept as floats
+            // so that the errors of converting them back to 8 bits do not accumulate along the chain.
+            std::vector<glm::vec4> colors = decode(base, pixelCount, colorSpace);
+            std::vector<unsigned char> pixels;
+            for(uint32_t level = 1; level < header.levelCount; level++){
+                glm::ivec2 levelSize = getLevelSize(image.size, level);
+                colors = downsample(colors, size, levelSize);
+                size = levelSize;
+                encode(colors, pixels, colorSpace);
+                file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+            }
+            if(!file) return false;
+        }
+        std::filesystem::remove(cachePath, error);
+        std::filesystem::rename(temporaryPath, cachePath, error);
+        if(error){
+            std::cerr << "Failed to write the texture cache \"" << cachePath << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    bool bake(const std::string& sourcePath, texture_utils::ColorSpace colorSpace, bool force) {
+        if(!force){
+            texture_utils::ImageData cached;
+            if(map(sourcePath, cached, colorSpace) && cached.levels.size() == getLevelCount(cached.size)) return true;
+        }
+        texture_utils::ImageData image = texture_utils::decodeImage(sourcePath, false);
+        if(!image.isLoaded()) return false;
+        return write(sourcePath, image, colorSpace);
+    }
+
+}
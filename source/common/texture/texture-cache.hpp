@@ -0,0 +1,57 @@
+#pragma once
+
+#include "texture-utils.hpp"
+#include <string>
+#include <cstdint>
+
+// The texture cache stores a decoded image together with its whole mip chain in a binary file next to it ("<image path>.tex").
+// The mip levels are computed offline (see "source/tools/texture-baker.cpp") using a box filter, so at runtime
+// the file is memory mapped and every level is sent directly to the texture without decoding the image or calling glGenerateMipmap.
+// The binary file layout is: TextureCacheHeader, then the "levelCount" levels from the largest to the smallest.
+// Each level is tightly packed with its rows ordered from the bottom to the top (like the images loaded by "texture_utils").
+// The box filter depends on the color space of the texture (see "texture_utils::ColorSpace"): the levels of a linear texture
+// are averaged as they are stored while the levels of an sRGB texture are averaged in linear space with premultiplied alpha.
+// A cache is only used for the color space it was baked for.
+namespace our::texture_cache {
+
+    // The formats in which the levels can be stored
+    enum class TextureCacheFormat : uint32_t {
+        RGBA8 = 0 // 4 bytes per pixel (the only format written by the baker for now)
+    };
+
+    // The header found at the start of every texture cache file
+    struct TextureCacheHeader {
+        char magic[4];          // Always "TEXC"
+        uint32_t version;       // The format version (TEXTURE_CACHE_VERSION)
+        uint32_t format;        // A TextureCacheFormat
+        uint32_t colorSpace;    // The texture_utils::ColorSpace used to filter the levels
+        uint32_t reserved;      // Always 0 (keeps "sourceSize" aligned)
+        uint32_t width;         // The size of the largest level
+        uint32_t height;
+        uint32_t levelCount;    // The number of mip levels stored in the file (at least 1)
+        uint64_t sourceSize;    // The source image size in bytes (a change in size invalidates the cache)
+    };
+
+    constexpr uint32_t TEXTURE_CACHE_VERSION = 2;
+
+    // Returns the path of the cache file of the given image file
+    std::string getCachePath(const std::string& sourcePath);
+
+    // Returns the number of levels in a full mip chain of the given size (down to 1x1)
+    uint32_t getLevelCount(glm::ivec2 size);
+
+    // Maps the cache of the given image file and fills "image" with its levels (without calling OpenGL)
+    // The cache is only used if it is newer than the source image (or if the source image is not shipped)
+    // and if it was baked for the given color space. If the cache does not exist or if it is stale, the function returns false
+    bool map(const std::string& sourcePath, texture_utils::ImageData& image, texture_utils::ColorSpace colorSpace);
+
+    // Computes the mip chain of the given decoded image in the given color space and writes it to the cache of the given image file
+    // Returns false if the cache could not be written
+    bool write(const std::string& sourcePath, const texture_utils::ImageData& image, texture_utils::ColorSpace colorSpace);
+
+    // Decodes the given image file and writes its cache for the given color space (without creating any OpenGL objects)
+    // If "force" is false and the cache is already up to date, nothing is done
+    // Returns false if the image could not be decoded or if the cache could not be written
+    bool bake(const std::string& sourcePath, texture_utils::ColorSpace colorSpace, bool force = false);
+
+}
@@ -1,4 +1,5 @@
 #include "texture-utils.hpp"
+#include "texture-cache.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
@@ -30,12 +31,39 @@ our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size){
     return texture;
 }
 
-our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool generate_mipmap) {
-    glm::ivec2 size;
+void our::texture_utils::PixelDeleter::operator()(unsigned char* pixels) const {
+    stbi_image_free(pixels);
+}
+
+our::texture_utils::TextureSource our::texture_utils::parseTextureSource(const nlohmann::json& desc) {
+    TextureSource source;
+    if(desc.is_string()){
+        source.path = desc.get<std::string>();
+    } else if(desc.is_object()){
+        source.path = desc.value("path", "");
+        std::string colorSpace = desc.value("colorSpace", "linear");
+        if(colorSpace == "srgb") source.colorSpace = ColorSpace::SRGB;
+        else if(colorSpace != "linear") std::cerr << "Unknown color space \"" << colorSpace << "\" of the texture: " << source.path << std::endl;
+    }
+    return source;
+}
+
+our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool generate_mipmap, ColorSpace colorSpace) {
+    ImageData image = decodeImage(filename, true, colorSpace);
+    if(!image.isLoaded()) return nullptr;
+    return uploadImage(image, generate_mipmap);
+}
+
+our::texture_utils::ImageData our::texture_utils::decodeImage(const std::string& filename, bool useCache, ColorSpace colorSpace) {
+    ImageData image;
+    // The baked image already contains the mip chain, so neither the decoding nor the mip generation is needed
+    if(useCache && texture_cache::map(filename, image, colorSpace)) return image;
+    glm::ivec2& size = image.size;
     int channels;
     //Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
     //We need to till stb to flip images vertically after loading them
-    stbi_set_flip_vertically_on_load(true);
+    //The flag is set for the current thread only since images can be decoded by multiple threads at the same time
+    stbi_set_flip_vertically_on_load_thread(true);
     //Load image data and retrieve width, height and number of channels in the image
     //The last argument is the number of channels we want and it can have the following values:
     //- 0: Keep number of channels the same as in the image file
@@ -47,8 +75,15 @@ our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool
     unsigned char* pixels = stbi_load(filename.c_str(), &size.x, &size.y, &channels, 4);
     if(pixels == nullptr){
         std::cerr << "Failed to load image: " << filename << std::endl;
-        return nullptr;
+        return image;
     }
+    image.pixels.reset(pixels);
+    image.levels.push_back({size, pixels});
+    return image;
+}
+
+our::Texture2D* our::texture_utils::uploadImage(const ImageData& image, bool generate_mipmap) {
+    const glm::ivec2& size = image.size;
     // Create a texture
     our::Texture2D* texture = new our::Texture2D();
     //Bind the texture such that we upload the image data to its storage
@@ -68,17 +103,32 @@ our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool
     // format : Specifies the format of the pixel data. (GL_RGBA)
     // type : Specifies the data type of the pixel data. (GL_UNSIGNED_BYTE)
     // data : Specifies a pointer to the image data in memory.
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.levels[0].pixels);
+    // 4 bytes per pixel (RGBA8)
+    size_t byteSize = (size_t)size.x * size.y * 4;
 
-    // Generate mipmaps for the texture
-    if(generate_mipmap){
+    if(image.levels.size() > 1){
+        // The image was baked with its mip chain, so the remaining levels are uploaded as they are
+        // If no mipmaps are needed, only the first level is used
+        int levelCount = generate_mipmap ? (int)image.levels.size() : 1;
+        for(int level = 1; level < levelCount; level++){
+            const ImageLevel& mip = image.levels[level];
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, mip.size.x, mip.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip.pixels);
+            byteSize += (size_t)mip.size.x * mip.size.y * 4;
+        }
+        // The texture is only complete if the sampler does not look for levels beyond the stored ones
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    } else if(generate_mipmap){
+        // Generate mipmaps for the texture
         // glGenerateMipmap(GLenum target);
         // target : Specifies the target texture. (Bind to GL_TEXTURE_2D)
         // The mipmaps are used for minification filtering (When the texture is smaller than the screen)
         // Nearest neighbor minification filtering or interpolation minification filtering
         glGenerateMipmap(GL_TEXTURE_2D);
+        // The mip chain adds about one third to the base level
+        byteSize = byteSize * 4 / 3;
     }
+    texture->setByteSize(byteSize);
     
-    stbi_image_free(pixels); //Free image data after uploading to GPU
     return texture;
 }
\ No newline at end of file
@@ -1,14 +1,70 @@
 #pragma once
 
 #include "texture2d.hpp"
+#include "../mapped-file.hpp"
 #include <string>
+#include <vector>
+#include <memory>
 
 #include <glad/gl.h>
 #include <glm/vec2.hpp>
+#include <json/json.hpp>
+#include <cstdint>
 
 namespace our::texture_utils {
+    // How the color channels of an image are stored, which decides how its mip levels are baked (see "texture-cache.hpp"):
+    // - LINEAR (the default): the levels are averaged as they are stored, like glGenerateMipmap does. This is right for the data
+    //   maps (e.g. roughness, specular or ambient occlusion) and for any image that is not known to hold colors.
+    // - SRGB: the channels hold colors encoded with the sRGB curve, so the levels are averaged in linear space with premultiplied alpha.
+    // Either way, the texture is uploaded as GL_RGBA so the shaders read the stored values.
+    enum class ColorSpace : uint32_t {
+        LINEAR = 0,
+        SRGB = 1
+    };
+
+    // The image file of a texture asset and its color space. In the asset configs, a texture is either the path of its image
+    // (which is linear) or an object: { "path": "path/to/image", "colorSpace": "srgb" }
+    struct TextureSource {
+        std::string path;
+        ColorSpace colorSpace = ColorSpace::LINEAR;
+    };
+    // Reads a texture source from its json description (the path is empty if the description is invalid)
+    TextureSource parseTextureSource(const nlohmann::json& desc);
+
+    // Frees the pixels allocated by the image decoder
+    struct PixelDeleter {
+        void operator()(unsigned char* pixels) const;
+    };
+
+    // A level of an image (RGBA with 8 bits per channel, rows ordered from the bottom to the top)
+    struct ImageLevel {
+        glm::ivec2 size = {0, 0};
+        const unsigned char* pixels = nullptr;
+    };
+
+    // The pixels of a decoded image (RGBA with 8 bits per channel) waiting to be uploaded to a texture
+    // The levels point either into "pixels" (if the image was decoded) or into the mapped texture cache file (if it was baked).
+    // A decoded image has a single level while a baked image has its whole mip chain.
+    struct ImageData {
+        glm::ivec2 size = {0, 0};
+        std::vector<ImageLevel> levels; // Empty if the image could not be loaded
+        // The owners of the levels
+        std::unique_ptr<unsigned char, PixelDeleter> pixels;
+        std::unique_ptr<MappedFile> file;
+
+        bool isLoaded() const { return !levels.empty(); }
+    };
+
     // This function create an empty texture with a specific format (useful for framebuffers)
     Texture2D* empty(GLenum format, glm::ivec2 size);
     // This function loads an image and sends its data to the given Texture2D 
-    Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
+    Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true, ColorSpace colorSpace = ColorSpace::LINEAR);
+    // This function decodes an image file into memory. It doesn't call OpenGL so it can be called from any thread.
+    // If "useCache" is true and the image has an up to date texture cache baked for the given color space (see "texture-cache.hpp"),
+    // the cache is mapped instead.
+    ImageData decodeImage(const std::string& filename, bool useCache = true, ColorSpace colorSpace = ColorSpace::LINEAR);
+    // This function creates a texture from a decoded image (it must be called from the OpenGL thread)
+    // If the image has baked mip levels, they are uploaded as they are (or ignored if "generate_mipmap" is false),
+    // otherwise the mip levels are generated by the driver.
+    Texture2D* uploadImage(const ImageData& image, bool generate_mipmap = true);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <cstddef>
 
 namespace our {
 
@@ -8,6 +9,8 @@ namespace our {
     class Texture2D {
         // The OpenGL object name of this texture 
         GLuint name = 0;
+        // The size of the texture's storage in bytes (it is set by whoever allocates the storage, e.g. "texture_utils")
+        size_t byteSize = 0;
     public:
         // This constructor creates an OpenGL texture and saves its object name in the member variable "name" 
         Texture2D() {
@@ -32,6 +35,10 @@ namespace our {
             return name;
         }
 
+        // Sets and gets the size of the texture's storage in bytes (used by the asset cache to track the memory usage)
+        void setByteSize(size_t size) { byteSize = size; }
+        size_t getByteSize() const { return byteSize; }
+
         // This method binds this texture to GL_TEXTURE_2D
         void bind() const {
             //DONE (Req 5) Complete this function
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+
+namespace our {
+
+    // A fixed set of worker threads that run the submitted jobs in the order they were submitted.
+    // It is used to run work that doesn't need the OpenGL context (e.g. decoding images & parsing models) in parallel.
+    // When the pool is destroyed, it waits for the remaining jobs to finish then joins the workers.
+    class ThreadPool {
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> jobs;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+
+        // The loop run by each worker: wait for a job, run it, repeat until the pool is stopping and no jobs are left
+        void work() {
+            while(true){
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this]{ return stopping || !jobs.empty(); });
+                    if(jobs.empty()) return;
+                    job = std::move(jobs.front());
+                    jobs.pop();
+                }
+                job();
+            }
+        }
+
+    public:
+        // By default, we leave a core for the main thread
+        static size_t getDefaultThreadCount() {
+            unsigned int cores = std::thread::hardware_concurrency();
+            return std::max(1u, cores > 1 ? cores - 1 : 1u);
+        }
+
+        explicit ThreadPool(size_t threadCount = getDefaultThreadCount()) {
+            for(size_t i = 0; i < threadCount; i++)
+                workers.emplace_back([this]{ work(); });
+        }
+
+        // Queues a job and returns a future that will hold its result (or the exception it threw)
+        template<typename Job>
+        auto submit(Job&& job) -> std::future<decltype(job())> {
+            using Result = decltype(job());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Job>(job));
+            std::future<Result> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.emplace([task]{ (*task)(); });
+            }
+            condition.notify_one();
+            return result;
+        }
+
+        size_t getThreadCount() const { return workers.size(); }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_all();
+            for(auto& worker : workers) worker.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+    };
+
+}
@@ -30,6 +30,10 @@ int main(int argc, char** argv) {
     // This is useful for testing multiple configurations in a batch
     // Default: 0 where the application runs indefinitely until manually closed
     int run_for_frames = args.get<int>("f", 0);
+    // If "--benchmark" is given, the start scene runs in a hidden window for "--warmup" frames then for "-f" measured frames
+    // using a fixed time step of "--timestep" seconds, and the frame timings are written as JSON to "-o" (or printed if missing).
+    // "--context" selects how the OpenGL context is created: "native" (default), "egl" or "osmesa".
+    bool benchmark = args.get<bool>("benchmark", false);
 
     // Open the config file and exit if failed
     std::ifstream file_in(config_path);
@@ -64,6 +68,17 @@ int main(int argc, char** argv) {
         app.changeState(app_config["start-scene"].get<std::string>());
     }
 
+    if(benchmark){
+        our::BenchmarkSettings settings;
+        settings.warmupFrames = args.get<int>("warmup", 60);
+        settings.measuredFrames = run_for_frames > 0 ? run_for_frames : 300;
+        settings.timestep = args.get<double>("timestep", 1.0 / 60.0);
+        settings.contextApi = args.get<std::string>("context", "native");
+        settings.outputPath = args.get<std::string>("o", "");
+        settings.configName = config_path;
+        app.setBenchmark(settings);
+    }
+
     // Finally run the application
     // Here, the application loop will run till the terminatio condition is statisfied
     return app.run(run_for_frames);
@@ -18,6 +18,8 @@ class Injuredstate: public our::State {
     our::FreeCameraControllerSystem cameraController;
     our::MovementSystem movementSystem;
     our::ColliderSystem colliderSystem;
+    // The interned names of the entities used by the win condition
+    const our::NameId monsterName = our::internName("monster"), winWallName = our::internName("win_wall"), playerName = our::internName("player");
 
     void onInitialize() override {
         // First of all, we get the scene configuration from the app config
@@ -39,17 +41,36 @@ class Injuredstate: public our::State {
         renderer.initialize(size, config["renderer_injured"]);
     }
 
-    void onDraw(double deltaTime) override {
+    void onUpdate(double fixedDeltaTime) override {
+        // The renderer draws the entities between the transforms they had before and after this step
+        world.storePreviousTransforms();
         // Here, we just run a bunch of systems to control the world logic
-        movementSystem.update(&world, (float)deltaTime);
-        cameraController.update(&world, (float)deltaTime);
+        movementSystem.update(&world, (float)fixedDeltaTime);
+        cameraController.move(&world, (float)fixedDeltaTime);
+        // Then we refresh the cached entity matrices once so that the following systems only read them
+        world.updateTransforms();
 
         health = 1; // Set health to 1
 
         // We update the collider system
-        colliderSystem.update(&world, (float)deltaTime);
+        colliderSystem.update(&world, (float)fixedDeltaTime);
+
+        // If no entites called monster exist, go to win state 
+        // The world's name index keeps these lookups constant time
+        size_t monster_count = world.countByName(monsterName);
+        our::Entity* win_wall = world.findByName(winWallName);
+        our::Entity* player = world.findByName(playerName);
+        if ((win_wall->localTransform.position.z + 0.5 >= player->localTransform.position.z) && (monster_count == 0))
+        {
+            getApp()->changeState("win");
+        }
+    }
+
+    void onRender(double alpha) override {
+        // The mouse input is applied once per frame (no matter how many simulation steps ran)
+        cameraController.look(&world);
         // And finally we use the renderer system to draw the scene
-        renderer.render(&world);
+        renderer.render(&world, (float)alpha);
 
         // Get a reference to the keyboard object
         auto& keyboard = getApp()->getKeyboard();
@@ -58,29 +79,6 @@ class Injuredstate: public our::State {
             // If the escape  key is pressed in this frame, go to the play state
             getApp()->changeState("menu");
         }
-
-        // If no entites called monster exist, go to win state 
-        int monster_count = 0;
-        our::Entity* win_wall = nullptr;
-        our::Entity* player = nullptr;
-        for(auto entity : world.getEntities()){
-            if (entity->name == "monster")
-            {
-                monster_count++;
-            }
-            if (entity->name == "win_wall")
-            {
-                win_wall = entity;
-            }
-            if (entity->name == "player")
-            {
-                player = entity;
-            }
-        }
-        if ((win_wall->localTransform.position.z + 0.5 >= player->localTransform.position.z) && (monster_count == 0))
-        {
-            getApp()->changeState("win");
-        }
     }
 
     std::string getName() override {
@@ -94,7 +92,10 @@ class Injuredstate: public our::State {
         cameraController.exit();
         // Clear the world
         world.clear();
-        // and we delete all the loaded assets to free memory on the RAM and the VRAM
-        our::clearAllAssets();
+        // and we release the loaded assets. They stay cached so that the next state can reuse them without reloading
+        auto& config = getApp()->getConfig()["scene"];
+        if(config.contains("assets")){
+            our::releaseAllAssets(config["assets"]);
+        }
     }
 };
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <flags/flags.h>
+
+#include <mesh/mesh-cache.hpp>
+#include <thread-pool.hpp>
+
+// This tool bakes the binary mesh caches (see "mesh/mesh-cache.hpp") of the given model files ahead of time
+// so that the game never needs to parse them at runtime.
+// Usage: MESH_BAKER [paths...] [--force]
+//  - paths: model files or directories (searched recursively for ".obj" files). Default: "assets/models"
+//  - force: rebuild the caches even if they are up to date (put it after the paths)
+int main(int argc, char** argv) {
+
+    flags::args args(argc, argv); // Parse the command line arguments
+    bool force = args.get<bool>("force", false);
+
+    std::vector<std::string> paths;
+    for(auto& path : args.positional()) paths.emplace_back(path);
+    if(paths.empty()) paths.emplace_back("assets/models");
+
+    // Collect all the model files found in the given paths
+    std::vector<std::string> models;
+    for(auto& path : paths){
+        std::error_code error;
+        if(std::filesystem::is_directory(path, error)){
+            for(auto& entry : std::filesystem::recursive_directory_iterator(path, error)){
+                if(entry.is_regular_file() && entry.path().extension() == ".obj")
+                    models.push_back(entry.path().generic_string());
+            }
+        } else if(std::filesystem::is_regular_file(path, error)) {
+            models.push_back(path);
+        } else {
+            std::cerr << "Couldn't find: " << path << std::endl;
+        }
+    }
+
+    // The models are independent so they are baked in parallel
+    std::vector<std::future<bool>> results;
+    {
+        our::ThreadPool pool;
+        for(auto& model : models)
+            results.push_back(pool.submit([&model, force]{ return our::mesh_cache::bake(model, force); }));
+    }
+
+    int failures = 0;
+    for(size_t i = 0; i < models.size(); i++){
+        if(results[i].get()){
+            std::cout << "Baked " << models[i] << " -> " << our::mesh_cache::getCachePath(models[i]) << std::endl;
+        } else {
+            std::cerr << "Failed to bake " << models[i] << std::endl;
+            failures++;
+        }
+    }
+    std::cout << models.size() - failures << "/" << models.size() << " meshes baked" << std::endl;
+    return failures == 0 ? 0 : -1;
+}
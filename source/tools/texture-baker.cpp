@@ -0,0 +1,114 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <flags/flags.h>
+
+#include <texture/texture-cache.hpp>
+#include <thread-pool.hpp>
+
+using our::texture_utils::TextureSource;
+using our::texture_utils::ColorSpace;
+
+// Returns true if the path has the extension of an image that can be decoded by "texture_utils"
+static bool isImage(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg";
+}
+
+// Returns true if the path has the extension of a config file
+static bool isConfig(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    return extension == ".json" || extension == ".jsonc";
+}
+
+// Adds the textures of every "textures" object found in the given json (searched recursively) with their color spaces
+static void collectTextures(const nlohmann::json& data, std::vector<TextureSource>& sources) {
+    if(data.is_object()){
+        for(auto& [key, value] : data.items()){
+            if(key == "textures" && value.is_object()){
+                for(auto& [name, desc] : value.items()){
+                    TextureSource source = our::texture_utils::parseTextureSource(desc);
+                    if(!source.path.empty()) sources.push_back(source);
+                }
+            } else {
+                collectTextures(value, sources);
+            }
+        }
+    } else if(data.is_array()){
+        for(auto& item : data) collectTextures(item, sources);
+    }
+}
+
+// This tool bakes the texture caches (see "texture/texture-cache.hpp") of the given images ahead of time
+// so that the game never needs to decode them or to generate their mipmaps at runtime.
+// A cache is only used by the game if it was baked for the color space with which the texture is loaded,
+// so the textures are best baked from the configs that load them.
+// Usage: TEXTURE_BAKER [paths...] [--srgb] [--force]
+//  - paths: config files (".json" & ".jsonc") whose textures are baked with the color spaces they declare,
+//           or image files and directories (searched recursively for ".png", ".jpg" & ".jpeg" files). Default: "config/app.jsonc"
+//  - srgb: bake the images & the directories given by path as sRGB colors instead of linear data (put it after the paths)
+//  - force: rebuild the caches even if they are up to date (put it after the paths)
+int main(int argc, char** argv) {
+
+    flags::args args(argc, argv); // Parse the command line arguments
+    bool force = args.get<bool>("force", false);
+    ColorSpace pathColorSpace = args.get<bool>("srgb", false) ? ColorSpace::SRGB : ColorSpace::LINEAR;
+
+    std::vector<std::string> paths;
+    for(auto& path : args.positional()) paths.emplace_back(path);
+    if(paths.empty()) paths.emplace_back("config/app.jsonc");
+
+    // Collect all the image files found in the given paths
+    std::vector<TextureSource> sources;
+    for(auto& path : paths){
+        std::error_code error;
+        if(std::filesystem::is_directory(path, error)){
+            for(auto& entry : std::filesystem::recursive_directory_iterator(path, error)){
+                if(entry.is_regular_file() && isImage(entry.path()))
+                    sources.push_back({entry.path().generic_string(), pathColorSpace});
+            }
+        } else if(std::filesystem::is_regular_file(path, error) && isConfig(path)) {
+            std::ifstream file(path);
+            nlohmann::json config = nlohmann::json::parse(file, nullptr, false, true);
+            if(config.is_discarded()) std::cerr << "Couldn't parse: " << path << std::endl;
+            else collectTextures(config, sources);
+        } else if(std::filesystem::is_regular_file(path, error)) {
+            sources.push_back({path, pathColorSpace});
+        } else {
+            std::cerr << "Couldn't find: " << path << std::endl;
+        }
+    }
+
+    // An image has a single cache, so it is baked once (with the first color space requested for it)
+    std::vector<TextureSource> images;
+    for(auto& source : sources){
+        auto it = std::find_if(images.begin(), images.end(), [&](const TextureSource& image){ return image.path == source.path; });
+        if(it == images.end()) images.push_back(source);
+        else if(it->colorSpace != source.colorSpace)
+            std::cerr << "The image " << source.path << " is used with two color spaces, so its cache only matches the first one" << std::endl;
+    }
+
+    // The images are independent so they are baked in parallel
+    std::vector<std::future<bool>> results;
+    {
+        our::ThreadPool pool;
+        for(auto& image : images)
+            results.push_back(pool.submit([&image, force]{ return our::texture_cache::bake(image.path, image.colorSpace, force); }));
+    }
+
+    int failures = 0;
+    for(size_t i = 0; i < images.size(); i++){
+        if(results[i].get()){
+            std::cout << "Baked " << images[i].path << (images[i].colorSpace == ColorSpace::SRGB ? " (srgb)" : " (linear)")
+                      << " -> " << our::texture_cache::getCachePath(images[i].path) << std::endl;
+        } else {
+            std::cerr << "Failed to bake " << images[i].path << std::endl;
+            failures++;
+        }
+    }
+    std::cout << images.size() - failures << "/" << images.size() << " textures baked" << std::endl;
+    return failures == 0 ? 0 : -1;
+}